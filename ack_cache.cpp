@@ -0,0 +1,115 @@
+/**
+ * @file	ack_cache.cpp
+ * @brief	参数查询应答缓存类实现
+ * @author	agent <agent@local>
+ * @version 	1.0.0
+ * @date 	2026-10-16
+ *
+ * @verbatim
+ * ============================================================================
+ * Copyright (c) Shenzhen Landun technology Co.,Ltd. 2026
+ * All rights reserved. 
+ * 
+ * Use of this software is controlled by the terms and conditions found in the
+ * license agreenment under which this software has been supplied or provided.
+ * ============================================================================
+ * 
+ * @endverbatim
+ * 
+ */
+
+
+#include <string.h>
+#include "debug.h"
+#include "tx_buffer.h"
+#include "packet_codec.h"
+#include "ack_cache.h"
+
+
+//各参数组查询应答的包长，与原有应答结构一致
+static const unsigned int packet_size[PARAM_GROUP_NUM] = {
+	sizeof(struct packet_img_gparm_ack),		//PARAM_GROUP_CAMERA
+	sizeof(struct packet_networparam_gparam_ack),	//PARAM_GROUP_NETWORK
+	sizeof(struct packet_uploadinfo_gparam_ack),	//PARAM_GROUP_UPLOAD
+	sizeof(struct packet_flash_gparam_ack),		//PARAM_GROUP_FLASH
+	sizeof(struct packet_deviceinfo_gparam_ack),	//PARAM_GROUP_DEVICE_INFO
+	sizeof(struct packet_deviceinfo_gparam_ack),	//PARAM_GROUP_TRAFFIC沿用设备信息应答结构
+};
+
+
+AckCache::AckCache()
+{
+	memset(_entries, 0, sizeof(_entries));
+}
+
+AckCache::~AckCache()
+{
+	Clear();
+}
+
+void AckCache::Clear()
+{
+	for (int i = 0; i < PARAM_GROUP_NUM; i++) {
+		if (_entries[i].buf != NULL)
+			tx_buffer_put(_entries[i].buf);
+		_entries[i].buf = NULL;
+	}
+}
+
+/**
+ * @function	struct TxBuffer *Build(int group, unsigned int *gen)
+ * @brief	按当前参数生成应答包，ack.id为修改计数，ack.type由发送方按请求填写
+ *
+ */
+struct TxBuffer *AckCache::Build(int group, unsigned int *gen)
+{
+	unsigned int size = packet_size[group];
+	struct TxBuffer *buf = tx_buffer_alloc(size);
+	if (buf == NULL)
+		return NULL;
+
+	memset(buf->data, 0, size);
+	struct packet_ack *packet = (struct packet_ack *)buf->data;
+	if (ParamStore::GetInstance()->Get(group, packet + 1, gen) < 0) {
+		tx_buffer_put(buf);
+		return NULL;
+	}
+
+	ack_fill(packet, size, *gen, 0, ACK_SUCCESS);
+	buf->len = size;
+
+	return buf;
+}
+
+/**
+ * @function	struct TxBuffer *Lookup(int group, unsigned int *gen)
+ * @brief	取参数组的应答包及其修改计数，参数已修改则重新生成。返回的缓冲
+ *		在下次Lookup或Clear之前有效，需长期持有时调用tx_buffer_get
+ *
+ */
+struct TxBuffer *AckCache::Lookup(int group, unsigned int *gen)
+{
+	if (group < 0 || group >= PARAM_GROUP_NUM)
+		return NULL;
+
+	struct Entry *entry = &_entries[group];
+	if (entry->buf != NULL &&
+	    entry->gen == ParamStore::GetInstance()->Generation(group)) {
+		*gen = entry->gen;
+		return entry->buf;
+	}
+
+	struct TxBuffer *buf = Build(group, gen);
+	if (buf == NULL) {
+		Debug("build ack cache failed, group %d", group);
+		return NULL;
+	}
+
+	//已进入输出队列的旧包由队列各自的引用保持到发送完成
+	if (entry->buf != NULL)
+		tx_buffer_put(entry->buf);
+	entry->buf = buf;
+	entry->gen = *gen;
+
+	return buf;
+}
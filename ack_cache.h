@@ -0,0 +1,55 @@
+/**
+ * @file	ack_cache.h
+ * @brief	参数查询应答缓存类声明
+ * @author	agent <agent@local>
+ * @version	1.0.0
+ * @date	2026-10-16
+ *
+ * @verbatim
+ * ============================================================================
+ * Copyright (c) Shenzhen Landun technology Co.,Ltd. 2026
+ * All rights reserved. 
+ * 
+ * Use of this software is controlled by the terms and conditions found in the
+ * license agreenment under which this software has been supplied or provided.
+ * ============================================================================
+ * 
+ * @endverbatim
+ * 
+ */
+
+
+#ifndef _ACKCACHE_H_
+#define _ACKCACHE_H_
+
+#include "param_store.h"
+
+struct TxBuffer;
+
+/**
+ * 每个参数组缓存一份序列化好的查询应答包(包头+packet_ack+参数)，
+ * 记录生成时ParamStore的修改计数，计数变化后下次查询时重新生成。
+ * 缓存包放在共享发送缓冲中，各连接的输出队列直接引用参数部分，
+ * 只有包头按请求修改后拷贝。仅由reactor线程使用。
+ */
+class AckCache
+{
+
+public:
+	AckCache();
+	~AckCache();
+
+	struct TxBuffer *Lookup(int group, unsigned int *gen);
+	void Clear();
+
+private:
+	struct Entry {
+		struct TxBuffer *buf;	//缓存的应答包
+		unsigned int gen;	//生成时的修改计数
+	};
+	struct Entry _entries[PARAM_GROUP_NUM];
+
+	struct TxBuffer *Build(int group, unsigned int *gen);
+};
+
+#endif
@@ -0,0 +1,158 @@
+/**
+ * @file	crc32c.cpp
+ * @brief	CRC32C(Castagnoli)校验实现
+ * @author	agent <agent@local>
+ * @version 	1.0.0
+ * @date 	2026-10-16
+ *
+ * @verbatim
+ * ============================================================================
+ * Copyright (c) Shenzhen Landun technology Co.,Ltd. 2026
+ * All rights reserved. 
+ * 
+ * Use of this software is controlled by the terms and conditions found in the
+ * license agreenment under which this software has been supplied or provided.
+ * ============================================================================
+ * 
+ * @endverbatim
+ * 
+ */
+
+
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <nmmintrin.h>
+#elif defined(__aarch64__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#include <arm_acle.h>
+#endif
+#include "crc32c.h"
+
+
+#define CRC32C_POLY	0x82F63B78	//反射多项式
+
+static uint32_t crc_table[8][256];
+static pthread_once_t crc_once = PTHREAD_ONCE_INIT;
+static uint32_t (*crc_update)(uint32_t crc, const uint8_t *p, size_t len);
+
+/* 查表实现(slicing-by-8)，无硬件CRC指令时使用 */
+static uint32_t crc32c_sw(uint32_t crc, const uint8_t *p, size_t len)
+{
+	while (len > 0 && ((uintptr_t)p & 0x07)) {
+		crc = crc_table[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+		len--;
+	}
+
+	while (len >= 8) {
+		uint32_t lo, hi;
+		memcpy(&lo, p, 4);
+		memcpy(&hi, p + 4, 4);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+		lo = __builtin_bswap32(lo);
+		hi = __builtin_bswap32(hi);
+#endif
+		lo ^= crc;
+		crc = crc_table[7][lo & 0xFF] ^ crc_table[6][(lo >> 8) & 0xFF] ^
+		      crc_table[5][(lo >> 16) & 0xFF] ^ crc_table[4][lo >> 24] ^
+		      crc_table[3][hi & 0xFF] ^ crc_table[2][(hi >> 8) & 0xFF] ^
+		      crc_table[1][(hi >> 16) & 0xFF] ^ crc_table[0][hi >> 24];
+		p += 8;
+		len -= 8;
+	}
+
+	while (len > 0) {
+		crc = crc_table[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+		len--;
+	}
+
+	return crc;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_hw(uint32_t crc, const uint8_t *p, size_t len)
+{
+	while (len > 0 && ((uintptr_t)p & 0x07)) {
+		crc = _mm_crc32_u8(crc, *p++);
+		len--;
+	}
+#if defined(__x86_64__)
+	uint64_t crc64 = crc;
+	while (len >= 8) {
+		uint64_t v;
+		memcpy(&v, p, 8);
+		crc64 = _mm_crc32_u64(crc64, v);
+		p += 8;
+		len -= 8;
+	}
+	crc = (uint32_t)crc64;
+#endif
+	while (len >= 4) {
+		uint32_t v;
+		memcpy(&v, p, 4);
+		crc = _mm_crc32_u32(crc, v);
+		p += 4;
+		len -= 4;
+	}
+	while (len > 0) {
+		crc = _mm_crc32_u8(crc, *p++);
+		len--;
+	}
+	return crc;
+}
+#elif defined(__aarch64__)
+__attribute__((target("+crc")))
+static uint32_t crc32c_hw(uint32_t crc, const uint8_t *p, size_t len)
+{
+	while (len > 0 && ((uintptr_t)p & 0x07)) {
+		crc = __crc32cb(crc, *p++);
+		len--;
+	}
+	while (len >= 8) {
+		uint64_t v;
+		memcpy(&v, p, 8);
+		crc = __crc32cd(crc, v);
+		p += 8;
+		len -= 8;
+	}
+	while (len > 0) {
+		crc = __crc32cb(crc, *p++);
+		len--;
+	}
+	return crc;
+}
+#endif
+
+static void crc32c_init()
+{
+	for (int i = 0; i < 256; i++) {
+		uint32_t crc = i;
+		for (int j = 0; j < 8; j++)
+			crc = (crc & 1) ? (crc >> 1) ^ CRC32C_POLY : crc >> 1;
+		crc_table[0][i] = crc;
+	}
+	for (int i = 0; i < 256; i++) {
+		for (int k = 1; k < 8; k++) {
+			uint32_t prev = crc_table[k - 1][i];
+			crc_table[k][i] = crc_table[0][prev & 0xFF] ^ (prev >> 8);
+		}
+	}
+
+	crc_update = crc32c_sw;
+#if defined(__x86_64__) || defined(__i386__)
+	if (__builtin_cpu_supports("sse4.2"))
+		crc_update = crc32c_hw;
+#elif defined(__aarch64__)
+	if (getauxval(AT_HWCAP) & HWCAP_CRC32)
+		crc_update = crc32c_hw;
+#endif
+}
+
+unsigned int crc32c(unsigned int crc, const void *data, unsigned int len)
+{
+	pthread_once(&crc_once, crc32c_init);
+	return ~crc_update(~crc, (const uint8_t *)data, len);
+}
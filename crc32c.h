@@ -0,0 +1,31 @@
+/**
+ * @file	crc32c.h
+ * @brief	CRC32C(Castagnoli)校验声明
+ * @author	agent <agent@local>
+ * @version	1.0.0
+ * @date	2026-10-16
+ *
+ * @verbatim
+ * ============================================================================
+ * Copyright (c) Shenzhen Landun technology Co.,Ltd. 2026
+ * All rights reserved. 
+ * 
+ * Use of this software is controlled by the terms and conditions found in the
+ * license agreenment under which this software has been supplied or provided.
+ * ============================================================================
+ * 
+ * @endverbatim
+ * 
+ */
+
+
+#ifndef _CRC32C_H_
+#define _CRC32C_H_
+
+/**
+ * 增量计算CRC32C，首次调用crc传0，结果可直接作为下次调用的crc。
+ * SSE4.2/ARMv8 CRC指令可用时使用硬件指令，否则查表计算。
+ */
+unsigned int crc32c(unsigned int crc, const void *data, unsigned int len);
+
+#endif
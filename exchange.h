@@ -0,0 +1,77 @@
+/**
+ * @file	exchange.h
+ * @brief	连接上多步交互的续接状态
+ * @author	agent <agent@local>
+ * @version	1.0.0
+ * @date	2026-10-16
+ *
+ * @verbatim
+ * ============================================================================
+ * Copyright (c) Shenzhen Landun technology Co.,Ltd. 2026
+ * All rights reserved. 
+ * 
+ * Use of this software is controlled by the terms and conditions found in the
+ * license agreenment under which this software has been supplied or provided.
+ * ============================================================================
+ * 
+ * @endverbatim
+ * 
+ */
+
+
+#ifndef _EXCHANGE_H_
+#define _EXCHANGE_H_
+
+#include "ldczn_protocol.h"
+#include "timer_wheel.h"
+
+/* 交互类型，reactor按类型调用对应的处理函数 */
+#define EXCHANGE_NONE		0
+#define EXCHANGE_UPGRADE	1	//整包流式升级
+#define EXCHANGE_TIME		2	//校时，等待工作线程完成后应答
+#define EXCHANGE_WORK		3	//等待一个工作线程任务完成后按任务类型应答
+
+/* 处理函数返回值 */
+#define EX_DONE			0	//交互结束，继续解析后续请求
+#define EX_WAIT			1	//等待数据、写盘/工作线程完成或超时
+#define EX_CLOSE		-1	//关闭连接
+
+struct Work;
+
+/**
+ * 一个连接同时至多一个交互，交互期间该连接的后续数据不按请求帧解析。
+ * 处理函数用下面的宏写成顺序流程，等待时返回EX_WAIT，reactor在数据到达、
+ * 工作线程完成或超时后重新调用，从上次等待处继续。等待点之间的局部变量
+ * 不保留，需要跨等待点的状态放在本结构或连接中，每个交互只占这几十字节。
+ */
+struct Exchange {
+	int  type;		//EXCHANGE_*
+	int  line;		//续接位置，0为开始
+	bool expired;		//等待超时
+	struct Timer timer;	//等待期限，CONN_TIMER_EXCHANGE
+	struct payload_req req;	//发起交互的请求，应答时回填
+	int  wait_work;		//等待的任务类型WORK_*，-1不等待
+	struct Work *work;	//已完成的工作线程任务，仅在本次调用期间有效
+};
+
+#define EX_BEGIN(ex)		switch ((ex)->line) { case 0:
+#define EX_END(ex)		} (ex)->line = 0; return EX_DONE
+
+/* 返回EX_WAIT，下次调用从此处之后继续 */
+#define EX_YIELD(ex)				\
+	do {					\
+		(ex)->line = __LINE__;		\
+		return EX_WAIT;			\
+	case __LINE__:;				\
+	} while (0)
+
+/* 条件满足或超时后继续 */
+#define EX_WAIT_UNTIL(ex, cond)			\
+	do {					\
+		(ex)->line = __LINE__;		\
+	case __LINE__:				\
+		if (!(cond) && !(ex)->expired)	\
+			return EX_WAIT;		\
+	} while (0)
+
+#endif
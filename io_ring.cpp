@@ -0,0 +1,377 @@
+/**
+ * @file	io_ring.cpp
+ * @brief	io_uring封装类实现
+ * @author	agent <agent@local>
+ * @version 	1.0.0
+ * @date 	2026-10-16
+ *
+ * @verbatim
+ * ============================================================================
+ * Copyright (c) Shenzhen Landun technology Co.,Ltd. 2026
+ * All rights reserved. 
+ * 
+ * Use of this software is controlled by the terms and conditions found in the
+ * license agreenment under which this software has been supplied or provided.
+ * ============================================================================
+ * 
+ * @endverbatim
+ * 
+ */
+
+
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include "debug.h"
+#include "io_ring.h"
+
+#ifdef CONFIG_IO_URING
+#include <linux/io_uring.h>
+
+#ifndef IORING_ACCEPT_MULTISHOT
+#define IORING_ACCEPT_MULTISHOT	(1U << 0)
+#endif
+#ifndef IORING_CQE_F_MORE
+#define IORING_CQE_F_MORE	(1U << 1)
+#endif
+#endif
+
+
+IoRing::IoRing()
+{
+	_fd = -1;
+	_features = 0;
+	_entries = 0;
+	_sq_ptr = NULL;
+	_cq_ptr = NULL;
+	_sq_size = 0;
+	_cq_size = 0;
+	_sqes = NULL;
+	_sq_head = NULL;
+	_sq_tail = NULL;
+	_sq_mask = NULL;
+	_sq_array = NULL;
+	_cq_head = NULL;
+	_cq_tail = NULL;
+	_cq_mask = NULL;
+	_cqes = NULL;
+	_sq_local = 0;
+	_pending = 0;
+}
+
+IoRing::~IoRing()
+{
+	Release();
+}
+
+#ifdef CONFIG_IO_URING
+
+/**
+ * @function	int Init(unsigned int entries)
+ * @brief	创建io_uring并映射SQ/CQ环
+ * @return	0成功，-1内核不支持或资源不足
+ */
+int IoRing::Init(unsigned int entries)
+{
+	struct io_uring_params params;
+	memset(&params, 0, sizeof(params));
+	_fd = syscall(__NR_io_uring_setup, entries, &params);
+	if (_fd < 0) {
+		Debug("io_uring unavailable, errno %d", errno);
+		return -1;
+	}
+
+	_features = params.features;
+	_entries = params.sq_entries;
+	_sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+	_cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	if (_features & IORING_FEAT_SINGLE_MMAP) {
+		if (_cq_size > _sq_size)
+			_sq_size = _cq_size;
+		_cq_size = _sq_size;
+	}
+
+	_sq_ptr = mmap(NULL, _sq_size, PROT_READ | PROT_WRITE,
+		       MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_SQ_RING);
+	if (_sq_ptr == MAP_FAILED) {
+		_sq_ptr = NULL;
+		Release();
+		return -1;
+	}
+
+	if (_features & IORING_FEAT_SINGLE_MMAP) {
+		_cq_ptr = _sq_ptr;
+	} else {
+		_cq_ptr = mmap(NULL, _cq_size, PROT_READ | PROT_WRITE,
+			       MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_CQ_RING);
+		if (_cq_ptr == MAP_FAILED) {
+			_cq_ptr = NULL;
+			Release();
+			return -1;
+		}
+	}
+
+	_sqes = mmap(NULL, params.sq_entries * sizeof(struct io_uring_sqe),
+		     PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+		     _fd, IORING_OFF_SQES);
+	if (_sqes == MAP_FAILED) {
+		_sqes = NULL;
+		Release();
+		return -1;
+	}
+
+	char *sq = (char *)_sq_ptr;
+	char *cq = (char *)_cq_ptr;
+	_sq_head  = (unsigned int *)(sq + params.sq_off.head);
+	_sq_tail  = (unsigned int *)(sq + params.sq_off.tail);
+	_sq_mask  = (unsigned int *)(sq + params.sq_off.ring_mask);
+	_sq_array = (unsigned int *)(sq + params.sq_off.array);
+	_cq_head  = (unsigned int *)(cq + params.cq_off.head);
+	_cq_tail  = (unsigned int *)(cq + params.cq_off.tail);
+	_cq_mask  = (unsigned int *)(cq + params.cq_off.ring_mask);
+	_cqes     = cq + params.cq_off.cqes;
+	_sq_local = *_sq_tail;
+	_pending  = 0;
+	return 0;
+}
+
+void IoRing::Release()
+{
+	if (_sqes != NULL)
+		munmap(_sqes, _entries * sizeof(struct io_uring_sqe));
+	if (_cq_ptr != NULL && _cq_ptr != _sq_ptr)
+		munmap(_cq_ptr, _cq_size);
+	if (_sq_ptr != NULL)
+		munmap(_sq_ptr, _sq_size);
+	_sqes = NULL;
+	_cq_ptr = NULL;
+	_sq_ptr = NULL;
+
+	if (_fd >= 0) {
+		close(_fd);
+		_fd = -1;
+	}
+}
+
+/* 文件写支持偏移-1(当前位置)，与write()的语义相同 */
+bool IoRing::CanWriteFile() const
+{
+	return _fd >= 0 && (_features & IORING_FEAT_RW_CUR_POS);
+}
+
+int IoRing::RegisterFiles(const int *fds, unsigned int count)
+{
+	if (_fd < 0)
+		return -1;
+	return syscall(__NR_io_uring_register, _fd, IORING_REGISTER_FILES,
+		       fds, count) < 0 ? -1 : 0;
+}
+
+void *IoRing::GetSqe()
+{
+	unsigned int head = *(volatile unsigned int *)_sq_head;
+	__sync_synchronize();
+	if (_sq_local - head >= _entries)
+		return NULL;
+
+	unsigned int index = _sq_local & *_sq_mask;
+	struct io_uring_sqe *sqe = (struct io_uring_sqe *)_sqes + index;
+	memset(sqe, 0, sizeof(*sqe));
+	_sq_array[index] = index;
+	_sq_local++;
+	_pending++;
+	return sqe;
+}
+
+/**
+ * @function	int PrepAccept(int fd, int flags, bool multishot, unsigned long long data)
+ * @brief	accept请求，multishot时一个请求持续产生新连接，直到完成事件不带MORE
+ * @return	0成功，-1提交队列已满
+ */
+int IoRing::PrepAccept(int fd, int flags, bool multishot, unsigned long long data)
+{
+	struct io_uring_sqe *sqe = (struct io_uring_sqe *)GetSqe();
+	if (sqe == NULL)
+		return -1;
+
+	sqe->opcode	  = IORING_OP_ACCEPT;
+	sqe->fd		  = fd;
+	sqe->accept_flags = flags;
+	if (multishot)
+		sqe->ioprio |= IORING_ACCEPT_MULTISHOT;
+	sqe->user_data	  = data;
+	return 0;
+}
+
+/**
+ * @function	int PrepSendmsg(int fd, const struct msghdr *msg, unsigned int flags,
+ *				unsigned long long data)
+ * @brief	sendmsg请求，msg及其iovec在完成前须保持有效；带MSG_DONTWAIT时
+ *		socket写满直接以-EAGAIN完成，不在内核中等待
+ */
+int IoRing::PrepSendmsg(int fd, const struct msghdr *msg, unsigned int flags,
+			unsigned long long data)
+{
+	struct io_uring_sqe *sqe = (struct io_uring_sqe *)GetSqe();
+	if (sqe == NULL)
+		return -1;
+
+	sqe->opcode	= IORING_OP_SENDMSG;
+	sqe->fd		= fd;
+	sqe->addr	= (unsigned long)msg;
+	sqe->len	= 1;
+	sqe->msg_flags	= flags;
+	sqe->user_data	= data;
+	return 0;
+}
+
+/**
+ * @function	int PrepWriteFixed(int index, const void *buf, unsigned int len,
+ *				   unsigned long long offset, unsigned long long data)
+ * @brief	写已注册的第index个文件，offset为(unsigned long long)-1时写当前位置
+ *
+ */
+int IoRing::PrepWriteFixed(int index, const void *buf, unsigned int len,
+			   unsigned long long offset, unsigned long long data)
+{
+	struct io_uring_sqe *sqe = (struct io_uring_sqe *)GetSqe();
+	if (sqe == NULL)
+		return -1;
+
+	sqe->opcode	= IORING_OP_WRITE;
+	sqe->flags	= IOSQE_FIXED_FILE;
+	sqe->fd		= index;
+	sqe->addr	= (unsigned long)buf;
+	sqe->len	= len;
+	sqe->off	= offset;
+	sqe->user_data	= data;
+	return 0;
+}
+
+/**
+ * @function	int Submit(unsigned int wait)
+ * @brief	一次系统调用提交全部已填写的请求，并等待至少wait个完成事件
+ * @return	提交的请求数，-1出错
+ */
+int IoRing::Submit(unsigned int wait)
+{
+	__sync_synchronize();
+	*(volatile unsigned int *)_sq_tail = _sq_local;
+
+	while (1) {
+		int ret = syscall(__NR_io_uring_enter, _fd, _pending, wait,
+				  wait > 0 ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret < 0)
+			return -1;
+
+		_pending -= ret;
+		return ret;
+	}
+}
+
+/**
+ * @function	bool Reap(unsigned long long *data, int *res, bool *more)
+ * @brief	取一个完成事件，more表示multishot请求还会产生后续事件
+ * @return	false没有完成事件
+ */
+bool IoRing::Reap(unsigned long long *data, int *res, bool *more)
+{
+	if (_fd < 0)
+		return false;
+
+	unsigned int head = *_cq_head;
+	unsigned int tail = *(volatile unsigned int *)_cq_tail;
+	__sync_synchronize();
+	if (head == tail)
+		return false;
+
+	struct io_uring_cqe *cqe = (struct io_uring_cqe *)_cqes + (head & *_cq_mask);
+	*data = cqe->user_data;
+	*res  = cqe->res;
+	if (more != NULL)
+		*more = (cqe->flags & IORING_CQE_F_MORE) != 0;
+
+	__sync_synchronize();
+	*(volatile unsigned int *)_cq_head = head + 1;
+	return true;
+}
+
+#else
+
+int IoRing::Init(unsigned int entries)
+{
+	entries = entries;
+	return -1;
+}
+
+void IoRing::Release()
+{
+}
+
+bool IoRing::CanWriteFile() const
+{
+	return false;
+}
+
+int IoRing::RegisterFiles(const int *fds, unsigned int count)
+{
+	fds = fds;
+	count = count;
+	return -1;
+}
+
+void *IoRing::GetSqe()
+{
+	return NULL;
+}
+
+int IoRing::PrepAccept(int fd, int flags, bool multishot, unsigned long long data)
+{
+	fd = fd;
+	flags = flags;
+	multishot = multishot;
+	data = data;
+	return -1;
+}
+
+int IoRing::PrepSendmsg(int fd, const struct msghdr *msg, unsigned int flags,
+			unsigned long long data)
+{
+	fd = fd;
+	msg = msg;
+	flags = flags;
+	data = data;
+	return -1;
+}
+
+int IoRing::PrepWriteFixed(int index, const void *buf, unsigned int len,
+			   unsigned long long offset, unsigned long long data)
+{
+	index = index;
+	buf = buf;
+	len = len;
+	offset = offset;
+	data = data;
+	return -1;
+}
+
+int IoRing::Submit(unsigned int wait)
+{
+	wait = wait;
+	return -1;
+}
+
+bool IoRing::Reap(unsigned long long *data, int *res, bool *more)
+{
+	data = data;
+	res = res;
+	more = more;
+	return false;
+}
+
+#endif
@@ -0,0 +1,81 @@
+/**
+ * @file	io_ring.h
+ * @brief	io_uring封装类声明
+ * @author	agent <agent@local>
+ * @version	1.0.0
+ * @date	2026-10-16
+ *
+ * @verbatim
+ * ============================================================================
+ * Copyright (c) Shenzhen Landun technology Co.,Ltd. 2026
+ * All rights reserved. 
+ * 
+ * Use of this software is controlled by the terms and conditions found in the
+ * license agreenment under which this software has been supplied or provided.
+ * ============================================================================
+ * 
+ * @endverbatim
+ * 
+ */
+
+
+#ifndef _IORING_H_
+#define _IORING_H_
+
+struct msghdr;
+
+/**
+ * 直接用系统调用操作io_uring，不依赖liburing。编译时定义CONFIG_IO_URING才启用，
+ * 否则或内核不支持时Init()返回-1，调用方继续使用epoll和普通系统调用。
+ * 不是线程安全的，每个使用线程各自一个实例。
+ */
+class IoRing
+{
+
+public:
+	IoRing();
+	~IoRing();
+
+	int  Init(unsigned int entries);
+	void Release();
+	bool Ready() const { return _fd >= 0; }
+	int  Fd() const { return _fd; }
+	bool CanWriteFile() const;
+
+	int  RegisterFiles(const int *fds, unsigned int count);
+
+	int  PrepAccept(int fd, int flags, bool multishot, unsigned long long data);
+	int  PrepSendmsg(int fd, const struct msghdr *msg, unsigned int flags,
+			 unsigned long long data);
+	int  PrepWriteFixed(int index, const void *buf, unsigned int len,
+			    unsigned long long offset, unsigned long long data);
+	int  Submit(unsigned int wait);
+	bool Reap(unsigned long long *data, int *res, bool *more);
+
+private:
+	int  _fd;
+	unsigned int _features;
+	unsigned int _entries;
+
+	void *_sq_ptr;		//SQ/CQ环映射
+	void *_cq_ptr;
+	unsigned int _sq_size;
+	unsigned int _cq_size;
+	void *_sqes;
+
+	unsigned int *_sq_head;
+	unsigned int *_sq_tail;
+	unsigned int *_sq_mask;
+	unsigned int *_sq_array;
+	unsigned int *_cq_head;
+	unsigned int *_cq_tail;
+	unsigned int *_cq_mask;
+	void *_cqes;
+
+	unsigned int _sq_local;	//已填写未提交的SQ尾
+	unsigned int _pending;	//待提交的SQE数
+
+	void *GetSqe();
+};
+
+#endif
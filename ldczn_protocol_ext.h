@@ -0,0 +1,241 @@
+/**
+ * @file	ldczn_protocol_ext.h
+ * @brief	ldczn协议扩展定义(TCP服务端新增报文)
+ * @author	agent <agent@local>
+ * @version	1.0.0
+ * @date	2026-10-16
+ *
+ * @verbatim
+ * ============================================================================
+ * Copyright (c) Shenzhen Landun technology Co.,Ltd. 2026
+ * All rights reserved. 
+ * 
+ * Use of this software is controlled by the terms and conditions found in the
+ * license agreenment under which this software has been supplied or provided.
+ * ============================================================================
+ * 
+ * @endverbatim
+ * 
+ */
+
+
+#ifndef _LDCZN_PROTOCOL_EXT_H_
+#define _LDCZN_PROTOCOL_EXT_H_
+
+#include <string.h>
+#include "ldczn_protocol.h"
+
+/* 填写标准包头，供各模块生成应答包 */
+static inline void fill_std_header(struct header_std *head,
+                                   char encoding,
+                                   char *auth_code,
+                                   char msg_type,
+                                   unsigned int msg_size)
+{
+        const char magic[] = PROTOCOL_MAGIC;
+        memcpy(head->magic, magic, sizeof(magic));
+        head->protocol_major = PROTOCOL_MAJOR;
+        head->protocol_minor = PROTOCOL_MINOR;
+        head->encoding       = encoding;
+        memcpy(head->auth_code, auth_code, sizeof(head->auth_code));
+        head->msg_type       = msg_type;
+        head->msg_size       = msg_size;
+}
+
+/* 扩展应答状态，取值避开ldczn_protocol.h中的ACK_* */
+#define ACK_EXT_FAILED		0x80	//处理失败
+#define ACK_EXT_BAD_LENGTH	0x81	//长度不符
+#define ACK_EXT_BAD_OFFSET	0x82	//分块偏移不连续，按durable重传
+#define ACK_EXT_CRC_MISMATCH	0x83	//升级文件CRC32C与请求不符，未安装
+#define ACK_EXT_INVALID		0x84	//参数取值非法
+#define ACK_EXT_UNSUPPORTED	0x85	//不支持的参数类型
+#define ACK_EXT_NOT_APPLIED	0x86	//参数合法，但因事务中其他项失败未生效
+#define ACK_EXT_NOT_MODIFIED	0x87	//条件查询: 参数未变化，应答不带参数
+#define ACK_EXT_BUSY		0x88	//设备繁忙，请求未处理，稍后重试
+
+/*
+ * 分块续传升级: REQ_MAN_UPG_APP请求类型的0x0000FF00位携带操作码。
+ * RESUME(payload_man_upgrade)开始或续接传输，应答返回已落盘字节数；
+ * 之后以CHUNK逐块发送，至多window块未确认；服务端每落盘一批回一次进度；
+ * 全部发送后以COMMIT完成安装。操作码为0时保持原有整包流式传输。
+ */
+#define REQ_MAN_UPG_OP_MASK	0x0000FF00
+#define UPG_OP_STREAM		0x00000000
+#define UPG_OP_RESUME		0x00000100
+#define UPG_OP_CHUNK		0x00000200
+#define UPG_OP_COMMIT		0x00000300
+
+/*
+ * 整包流式传输的开始请求: 在payload_man_upgrade后可附带整个文件的CRC32C，
+ * 附带时收满后核对，不符回ACK_EXT_CRC_MISMATCH且不安装；
+ * 不附带(旧客户端)时不作校验。
+ */
+struct payload_upgrade_stream {
+	struct payload_man_upgrade	upgrade;
+	unsigned int			crc32c;
+};
+
+/* CHUNK请求: 其后紧跟length字节数据，整帧长度由header_std.msg_size给出 */
+struct payload_upgrade_chunk {
+	unsigned int offset;
+	unsigned int length;
+};
+
+/* COMMIT请求: crc32c与接收时计算的值不符则拒绝安装 */
+struct payload_upgrade_commit {
+	unsigned int total_length;
+	unsigned int crc32c;
+};
+
+/* RESUME应答及CHUNK进度应答 */
+struct payload_upgrade_progress {
+	unsigned int total_length;
+	unsigned int durable;		//已落盘字节数，即续传起点
+	unsigned int chunk_size;	//单块最大数据长度
+	unsigned int window;		//允许未确认的块数
+	unsigned int crc32c;		//已接收部分的CRC32C，续传前可供客户端核对
+};
+
+struct packet_man_upgrade_progress_ack {
+	struct packet_man_upgrade_ack	upgrade;
+	struct payload_upgrade_progress	progress;
+};
+
+/* 扩展应答的公共部分，与各packet_*_ack中的ack成员布局相同 */
+struct packet_ext_ack {
+	struct header_std	head;
+	struct payload_ack	ack;
+};
+
+/*
+ * 参数TLV: type为PARAM_TYPE_*右移16位，length为value长度，
+ * 每项按4字节对齐
+ */
+struct param_tlv {
+	unsigned short type;
+	unsigned short length;
+};
+
+#define PARAM_TLV_ALIGN(n)	(((n) + 3) & ~3U)
+#define PARAM_TLV_TYPE(param_type)	((unsigned short)((param_type) >> 16))
+
+/*
+ * REQ_TYPE_GET_PARAMETER | PARAM_TYPE_ALL: 应答为packet_ext_ack后跟
+ * 相机、网络、上传、闪光灯、设备信息、交通参数的TLV，取自同一时刻的参数。
+ * REQ_TYPE_SET_PARAMETER | PARAM_TYPE_ALL: payload_req后跟若干参数TLV
+ * (相机、网络、上传、闪光灯、设备信息、时间)，全部校验通过后一起生效，
+ * 只落盘一次；应答为packet_ext_ack后跟每项的param_status。
+ */
+#define PARAM_TYPE_ALL		0x00F00000
+#define PARAM_TLV_MAX		8	//一次事务最多的TLV数
+
+/* PARAM_TYPE_ALL查询应答中TLV的顺序，下标与参数组编号(PARAM_GROUP_*)相同，
+ * 设置时也按此表由TLV类型找到参数组 */
+static const unsigned int param_all_types[] = {
+	PARAM_TYPE_CAMERA,
+	PARAM_TYPE_NETWORK,
+	PARAM_TYPE_UPLOAD,
+	PARAM_TYPE_FLASH,
+	PARAM_TYPE_DEVICE_INFO,
+	PARAM_TYPE_TRAFFIC,
+};
+#define PARAM_ALL_TYPES	(sizeof(param_all_types) / sizeof(param_all_types[0]))
+
+/*
+ * 参数修改计数: 参数查询应答的ack.id为该组参数的修改计数(查询全部时为各组之和)，
+ * 参数每次修改后变化，设备重启后重新取起始值。
+ * 条件查询: REQ_TYPE_GET_PARAMETER请求置PARAM_GET_CONDITIONAL位，req.id填客户端
+ * 已有的修改计数；计数相同时只回packet_ack，status为ACK_EXT_NOT_MODIFIED。
+ */
+#define PARAM_GET_CONDITIONAL	0x00008000
+
+struct param_status {
+	unsigned short type;
+	unsigned short status;
+};
+
+/*
+ * 变化通知订阅: REQ_TYPE_SUBSCRIBE请求后跟payload_subscribe，events为关注的
+ * NOTIFY_EVENT_*位，为0时取消订阅。订阅后设备在参数组修改、视频/抓拍模式切换、
+ * 校时后主动发送MESSAGE_TYPE_NOTIFY消息: 包头后跟payload_notify和length字节数据
+ * (参数组为修改后的参数结构，模式切换为CTL_TYPE_*，校时为Ldczn_time)。
+ * 输出队列积压的连接会丢弃通知，客户端可比较参数修改计数后重新查询。
+ */
+#define REQ_TYPE_SUBSCRIBE	0x0F000000
+#define MESSAGE_TYPE_NOTIFY	0x80
+
+#define NOTIFY_EVENT_PARAM(group)	(1U << (group))	//PARAM_GROUP_*
+#define NOTIFY_EVENT_MODE	0x00000100
+#define NOTIFY_EVENT_TIME	0x00000200
+
+struct payload_subscribe {
+	unsigned int events;
+};
+
+struct payload_notify {
+	unsigned int event;	//单个NOTIFY_EVENT_*位
+	unsigned int gen;	//参数组的修改计数，其他事件为0
+	unsigned int length;	//后续数据长度
+};
+
+/*
+ * UDP控制通道(UDP 39002): 只接受心跳和手动抓拍请求，格式与TCP相同，
+ * req.id为客户端递增的序号，设备按客户端地址做重放检查，应答的ack.id为该序号。
+ * 应答丢失时用同一序号重发，设备不会重复抓拍；其他请求回复ACK_EXT_UNSUPPORTED。
+ */
+
+/*
+ * 心跳应答: packet_ack后跟设备时间。连接发过心跳后按timeout_ms判断存活，
+ * 超时未收到任何数据即断开；未发心跳的连接按较长的空闲超时断开。
+ */
+struct payload_heartbeat {
+	unsigned int sec;		//设备UTC时间
+	unsigned int usec;
+	unsigned int uptime_ms;		//开机时长(毫秒)
+	unsigned int timeout_ms;	//心跳超时
+};
+
+struct packet_heartbeat_ack {
+	struct packet_ack		ack;
+	struct payload_heartbeat	time;
+};
+
+/* 升级应答附带的传输统计 */
+struct payload_upgrade_stat {
+	unsigned int received;		//已接收字节数
+	unsigned int elapsed_ms;	//传输耗时(毫秒)
+	unsigned int throughput;	//吞吐率(0.01MB/s)
+	unsigned int crc32c;		//接收数据的CRC32C
+};
+
+struct packet_man_upgrade_stat_ack {
+	struct packet_man_upgrade_ack	upgrade;
+	struct payload_upgrade_stat	stat;
+};
+
+/*
+ * 内存池占用: REQ_TYPE_GET_PARAMETER | PARAM_TYPE_METRICS，应答为packet_ext_ack
+ * 后跟POOL_METRIC_NUM个payload_pool_stat，按POOL_METRIC_*顺序排列。
+ * 连接池为处理该请求的reactor分片的，发送缓冲和工作任务为全进程共用。
+ */
+#define PARAM_TYPE_METRICS	0x00F10000
+
+#define POOL_METRIC_CONN	0	//连接对象
+#define POOL_METRIC_TX_BUFFER	1	//发送缓冲
+#define POOL_METRIC_WORK	2	//工作线程任务
+#define POOL_METRIC_NUM		3
+
+struct payload_pool_stat {
+	unsigned int size;		//对象大小
+	unsigned int total;		//已申请的对象数
+	unsigned int in_use;		//使用中的对象数
+	unsigned int peak;		//使用中的最大值
+	unsigned int fails;		//分配失败次数
+};
+
+struct packet_pool_metrics_ack {
+	struct packet_ext_ack		ack;
+	struct payload_pool_stat	pool[POOL_METRIC_NUM];
+};
+
+#endif
@@ -0,0 +1,81 @@
+/**
+ * @file	packet_codec.h
+ * @brief	协议报文视图和应答写入
+ * @author	agent <agent@local>
+ * @version	1.0.0
+ * @date	2026-10-16
+ *
+ * @verbatim
+ * ============================================================================
+ * Copyright (c) Shenzhen Landun technology Co.,Ltd. 2026
+ * All rights reserved. 
+ * 
+ * Use of this software is controlled by the terms and conditions found in the
+ * license agreenment under which this software has been supplied or provided.
+ * ============================================================================
+ * 
+ * @endverbatim
+ * 
+ */
+
+
+#ifndef _PACKETCODEC_H_
+#define _PACKETCODEC_H_
+
+#include <string.h>
+#include "ldczn_protocol_ext.h"
+
+/* 协议结构按主机字节序直接收发，设备和客户端均为小端，其他平台编译时报错 */
+typedef char packet_codec_little_endian[
+	__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__ ? 1 : -1];
+
+/**
+ * @function	const T *payload_view(const char *buf, const char *end, T *copy)
+ * @brief	请求负载的只读视图，end为按header_std.msg_size得到的帧结束位置。
+ *		按T对齐时直接返回buf(与原来的强制转换相同)，未对齐时拷贝到copy
+ * @return	长度不足返回NULL
+ */
+template <typename T>
+static inline const T *payload_view(const char *buf, const char *end, T *copy)
+{
+	if (buf > end || (unsigned long)(end - buf) < sizeof(T))
+		return NULL;
+	if (((unsigned long)buf & (__alignof__(T) - 1)) == 0)
+		return (const T *)buf;
+
+	memcpy(copy, buf, sizeof(T));
+	return copy;
+}
+
+/**
+ * @function	void ack_fill(void *packet, unsigned int len, unsigned int id,
+ *			      unsigned int type, unsigned int status)
+ * @brief	在packet处写入应答包头和payload_ack，len为整包长度，
+ *		用于变长应答；定长应答用下面的模板版本
+ */
+static inline void ack_fill(void *packet, unsigned int len, unsigned int id,
+			    unsigned int type, unsigned int status)
+{
+	struct packet_ext_ack *ack = (struct packet_ext_ack *)packet;
+	char	auth_code[sizeof(ack->head)];
+	memset(auth_code, 0, sizeof(auth_code));
+	fill_std_header(&ack->head, ENCODING_TYPE_RAW, auth_code,
+			MESSAGE_TYPE_ACK, len);
+
+	ack->ack.id	= id;
+	ack->ack.type	= type;
+	ack->ack.status	= status;
+}
+
+/* 定长应答: P须以包头和payload_ack开头(与packet_ext_ack布局相同)，长度取sizeof(P) */
+template <typename P>
+static inline P *ack_fill(P *packet, unsigned int id, unsigned int type,
+			  unsigned int status)
+{
+	typedef char packet_too_small[
+		sizeof(P) >= sizeof(struct packet_ext_ack) ? 1 : -1] __attribute__((unused));
+	ack_fill((void *)packet, sizeof(P), id, type, status);
+	return packet;
+}
+
+#endif
@@ -0,0 +1,209 @@
+/**
+ * @file	param_coalescer.cpp
+ * @brief	相机/闪光灯参数合并下发类实现
+ * @author	agent <agent@local>
+ * @version 	1.0.0
+ * @date 	2026-10-16
+ *
+ * @verbatim
+ * ============================================================================
+ * Copyright (c) Shenzhen Landun technology Co.,Ltd. 2026
+ * All rights reserved. 
+ * 
+ * Use of this software is controlled by the terms and conditions found in the
+ * license agreenment under which this software has been supplied or provided.
+ * ============================================================================
+ * 
+ * @endverbatim
+ * 
+ */
+
+
+#include <unistd.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/timerfd.h>
+#include "debug.h"
+#include "sensor_shadow.h"
+#include "work_pool.h"
+#include "param_store.h"
+#include "param_coalescer.h"
+
+
+ParamCoalescer::ParamCoalescer(SensorShadow *shadow, WorkPool *pool)
+{
+	_shadow = shadow;
+	_pool = pool;
+	_timer_fd = -1;
+	_window_ms = COALESCE_WINDOW_MS;
+	_armed = false;
+	memset(&_camera, 0, sizeof(_camera));
+	_camera_fields = 0;
+	memset(&_flash, 0, sizeof(_flash));
+	_flash_pending = false;
+	pthread_mutex_init(&_lock, NULL);
+}
+
+ParamCoalescer::~ParamCoalescer()
+{
+	Flush();
+	if (_timer_fd >= 0)
+		close(_timer_fd);
+	pthread_mutex_destroy(&_lock);
+}
+
+int ParamCoalescer::Init()
+{
+	_timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (_timer_fd < 0) {
+		Debug("create coalesce timer failed");
+		_window_ms = 0;
+		return -1;
+	}
+
+	return 0;
+}
+
+void ParamCoalescer::Arm()
+{
+	struct itimerspec its;
+	memset(&its, 0, sizeof(its));
+	its.it_value.tv_sec  = _window_ms / 1000;
+	its.it_value.tv_nsec = (_window_ms % 1000) * 1000000;
+	timerfd_settime(_timer_fd, 0, &its, NULL);
+	_armed = true;
+}
+
+static void camera_job(struct Work *work)
+{
+	SensorShadow *shadow = (SensorShadow *)work->arg;
+	shadow->Lock();
+	shadow->ApplyCamera((CameraParam *)work->data, work->value);
+	shadow->Unlock();
+}
+
+static void flash_job(struct Work *work)
+{
+	SensorShadow *shadow = (SensorShadow *)work->arg;
+	shadow->Lock();
+	shadow->ApplyFlash((FlashParam *)work->data);
+	shadow->Unlock();
+}
+
+void ParamCoalescer::ApplyCamera(const CameraParam *setting, unsigned int fields)
+{
+	struct Work *work = WorkPool::Alloc(WORK_CLASS_SENSOR, WORK_SENSOR, camera_job);
+	work->arg   = _shadow;
+	work->value = fields;
+	memcpy(work->data, setting, sizeof(*setting));
+	_pool->Post(work);
+}
+
+void ParamCoalescer::ApplyFlash(const FlashParam *setting)
+{
+	struct Work *work = WorkPool::Alloc(WORK_CLASS_SENSOR, WORK_SENSOR, flash_job);
+	work->arg = _shadow;
+	memcpy(work->data, setting, sizeof(*setting));
+	_pool->Post(work);
+}
+
+/**
+ * @function	void SetCamera(unsigned int fields)
+ * @brief	相机参数已保存到ParamStore；窗口空闲时立即下发，否则合并到窗口
+ *		到期时下发
+ *
+ */
+void ParamCoalescer::SetCamera(unsigned int fields)
+{
+	pthread_mutex_lock(&_lock);
+	if (_window_ms == 0 || !_armed) {
+		//加锁后读取，后保存的参数一定后下发
+		_camera = ParamStore::GetInstance()->GetCameraParam();
+		ApplyCamera(&_camera, fields);
+		if (_window_ms != 0)
+			Arm();
+	} else {
+		_camera_fields |= fields;
+	}
+	pthread_mutex_unlock(&_lock);
+}
+
+void ParamCoalescer::SetFlash()
+{
+	pthread_mutex_lock(&_lock);
+	if (_window_ms == 0 || !_armed) {
+		_flash = ParamStore::GetInstance()->GetFlashParam();
+		ApplyFlash(&_flash);
+		if (_window_ms != 0)
+			Arm();
+	} else {
+		_flash_pending = true;
+	}
+	pthread_mutex_unlock(&_lock);
+}
+
+/**
+ * @function	void ApplyNow(bool camera, bool flash)
+ * @brief	不经合并窗口立即下发(参数事务使用)，窗口内待下发的设置一并下发
+ *
+ */
+void ParamCoalescer::ApplyNow(bool camera, bool flash)
+{
+	pthread_mutex_lock(&_lock);
+	if (camera)
+		_camera_fields = CAMERA_FIELD_ALL;
+	if (flash)
+		_flash_pending = true;
+	Drain();
+	pthread_mutex_unlock(&_lock);
+}
+
+/**
+ * @function	void Flush()
+ * @brief	立即下发窗口内合并的参数
+ *
+ */
+void ParamCoalescer::Flush()
+{
+	pthread_mutex_lock(&_lock);
+	Drain();
+	pthread_mutex_unlock(&_lock);
+}
+
+//持锁调用，下发ParamStore中的当前值
+void ParamCoalescer::Drain()
+{
+	if (_camera_fields != 0) {
+		unsigned int fields = _camera_fields;
+		_camera_fields = 0;
+		_camera = ParamStore::GetInstance()->GetCameraParam();
+		ApplyCamera(&_camera, fields);
+	}
+
+	if (_flash_pending) {
+		_flash_pending = false;
+		_flash = ParamStore::GetInstance()->GetFlashParam();
+		ApplyFlash(&_flash);
+	}
+}
+
+/**
+ * @function	void OnTimer()
+ * @brief	窗口到期: 有合并的设置则下发并继续开启窗口，否则关闭窗口
+ *
+ */
+void ParamCoalescer::OnTimer()
+{
+	uint64_t expired;
+	ssize_t ret = read(_timer_fd, &expired, sizeof(expired));
+	ret = ret;
+
+	pthread_mutex_lock(&_lock);
+	if (_camera_fields == 0 && !_flash_pending) {
+		_armed = false;
+	} else {
+		Drain();
+		Arm();
+	}
+	pthread_mutex_unlock(&_lock);
+}
@@ -0,0 +1,79 @@
+/**
+ * @file	param_coalescer.h
+ * @brief	相机/闪光灯参数合并下发类声明
+ * @author	agent <agent@local>
+ * @version	1.0.0
+ * @date	2026-10-16
+ *
+ * @verbatim
+ * ============================================================================
+ * Copyright (c) Shenzhen Landun technology Co.,Ltd. 2026
+ * All rights reserved. 
+ * 
+ * Use of this software is controlled by the terms and conditions found in the
+ * license agreenment under which this software has been supplied or provided.
+ * ============================================================================
+ * 
+ * @endverbatim
+ * 
+ */
+
+
+#ifndef _PARAMCOALESCER_H_
+#define _PARAMCOALESCER_H_
+
+#include <pthread.h>
+#include "ldczn_protocol.h"
+
+#define COALESCE_WINDOW_MS	20	//默认合并窗口
+
+class SensorShadow;
+class WorkPool;
+
+/**
+ * 调参界面拖动滑块时会连续发送相机/闪光灯参数。窗口空闲时的第一次设置
+ * 立即下发到传感器并开启窗口；窗口内的后续设置只保留最后一次，窗口到期
+ * 时统一下发一次，直到不再有新的设置。参数保存由ParamStore负责。
+ * 下发在传感器工作线程中执行，SensorShadow只由该线程访问。
+ * 各分片共用主reactor的合并器，调用加锁；下发的是加锁后读取的ParamStore
+ * 当前值，最后一次下发总是最后一次保存的参数，分片间交错不会使传感器落后。
+ */
+class ParamCoalescer
+{
+
+public:
+	ParamCoalescer(SensorShadow *shadow, WorkPool *pool);
+	~ParamCoalescer();
+
+	int  Init();
+	int  Fd() const { return _timer_fd; }
+	void SetWindow(unsigned int ms) { _window_ms = ms; }
+	unsigned int Window() const { return _window_ms; }
+
+	void SetCamera(unsigned int fields);
+	void SetFlash();
+	void ApplyNow(bool camera, bool flash);
+
+	void OnTimer();
+	void Flush();
+
+private:
+	SensorShadow *_shadow;
+	WorkPool *_pool;
+	int  _timer_fd;
+	unsigned int _window_ms;
+	bool _armed;		//窗口已开启
+
+	CameraParam  _camera;	//窗口内最后一次相机参数
+	unsigned int _camera_fields;	//窗口内涉及的字段，0表示无待下发
+	FlashParam   _flash;
+	bool _flash_pending;
+	pthread_mutex_t _lock;
+
+	void Arm();
+	void Drain();
+	void ApplyCamera(const CameraParam *setting, unsigned int fields);
+	void ApplyFlash(const FlashParam *setting);
+};
+
+#endif
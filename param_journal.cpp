@@ -0,0 +1,368 @@
+/**
+ * @file	param_journal.cpp
+ * @brief	参数日志类实现
+ * @author	agent <agent@local>
+ * @version 	1.0.0
+ * @date 	2026-10-16
+ *
+ * @verbatim
+ * ============================================================================
+ * Copyright (c) Shenzhen Landun technology Co.,Ltd. 2026
+ * All rights reserved. 
+ * 
+ * Use of this software is controlled by the terms and conditions found in the
+ * license agreenment under which this software has been supplied or provided.
+ * ============================================================================
+ * 
+ * @endverbatim
+ * 
+ */
+
+
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "debug.h"
+#include "crc32c.h"
+#include "param_journal.h"
+
+
+#define JOURNAL_SEG_MAGIC	0x4C4A4450	//"PDJL"
+#define JOURNAL_REC_MAGIC	0x52
+#define JOURNAL_GROUP_COMMIT	0xFF
+
+struct journal_header {
+	uint32_t magic;
+	uint32_t epoch;
+	uint32_t reserved;
+	uint32_t crc;
+};
+
+struct journal_record {
+	uint8_t  magic;
+	uint8_t  group;
+	uint16_t len;
+	uint32_t seq;
+	uint32_t crc;		//group/len/seq及数据的CRC32C
+};
+
+#define JOURNAL_ALIGN(n)	(((n) + 3) & ~3U)
+
+static uint32_t record_crc(const struct journal_record *rec, const void *data)
+{
+	uint32_t crc = crc32c(0, &rec->group, sizeof(rec->group));
+	crc = crc32c(crc, &rec->len, sizeof(rec->len));
+	crc = crc32c(crc, &rec->seq, sizeof(rec->seq));
+	return crc32c(crc, data, rec->len);
+}
+
+ParamJournal::ParamJournal()
+{
+	for (int i = 0; i < 2; i++) {
+		_seg[i].fd = -1;
+		_seg[i].base = NULL;
+		_seg[i].epoch = 0;
+		_seg[i].tail = sizeof(struct journal_header);
+		_seg[i].synced = _seg[i].tail;
+	}
+	_active = 0;
+	_seq = 1;
+	_pending = false;
+}
+
+ParamJournal::~ParamJournal()
+{
+	Close();
+}
+
+int ParamJournal::OpenSegment(struct Segment *seg, const char *path)
+{
+	seg->fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+	if (seg->fd < 0) {
+		Debug("open %s failed", path);
+		return -1;
+	}
+
+	struct stat st;
+	if (fstat(seg->fd, &st) < 0 ||
+	    (st.st_size < JOURNAL_SEGMENT_SIZE &&
+	     ftruncate(seg->fd, JOURNAL_SEGMENT_SIZE) < 0)) {
+		Debug("resize %s failed", path);
+		return -1;
+	}
+
+	void *base = mmap(NULL, JOURNAL_SEGMENT_SIZE, PROT_READ | PROT_WRITE,
+			  MAP_SHARED, seg->fd, 0);
+	if (base == MAP_FAILED) {
+		Debug("mmap %s failed", path);
+		return -1;
+	}
+	seg->base = (char *)base;
+
+	struct journal_header *head = (struct journal_header *)seg->base;
+	if (head->magic == JOURNAL_SEG_MAGIC &&
+	    head->crc == crc32c(0, head, offsetof(struct journal_header, crc)))
+		seg->epoch = head->epoch;
+	else
+		seg->epoch = 0;
+
+	return 0;
+}
+
+/**
+ * @function	int Open(const char *path)
+ * @brief	打开并映射两个段文件
+ *
+ */
+int ParamJournal::Open(const char *path)
+{
+	char name[256];
+	for (int i = 0; i < 2; i++) {
+		snprintf(name, sizeof(name), "%s.%d", path, i);
+		if (OpenSegment(&_seg[i], name) < 0) {
+			Close();
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+void ParamJournal::Close()
+{
+	for (int i = 0; i < 2; i++) {
+		if (_seg[i].base != NULL) {
+			munmap(_seg[i].base, JOURNAL_SEGMENT_SIZE);
+			_seg[i].base = NULL;
+		}
+		if (_seg[i].fd >= 0) {
+			close(_seg[i].fd);
+			_seg[i].fd = -1;
+		}
+	}
+}
+
+int ParamJournal::SyncSegment(struct Segment *seg, unsigned int from, unsigned int to)
+{
+	long page = sysconf(_SC_PAGESIZE);
+	unsigned int start = from & ~(page - 1);
+	if (to > start && msync(seg->base + start, to - start, MS_SYNC) < 0) {
+		Debug("sync parameter journal failed, %s", strerror(errno));
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * @function	int Scan(struct Segment *seg, ReplayFunc func, void *ctx)
+ * @brief	回放一个段中已提交的记录，遇到校验失败或序号不连续即停止
+ * @return	已提交部分的结束位置
+ */
+int ParamJournal::Scan(struct Segment *seg, ReplayFunc func, void *ctx)
+{
+	unsigned int off = sizeof(struct journal_header);
+	unsigned int committed = off;
+	uint32_t seq = 0;
+
+	//第一遍找到最后一条提交记录，第二遍只应用其之前的记录
+	for (int pass = 0; pass < 2; pass++) {
+		off = sizeof(struct journal_header);
+		seq = 0;
+		while (off + sizeof(struct journal_record) <= JOURNAL_SEGMENT_SIZE) {
+			struct journal_record *rec = (struct journal_record *)(seg->base + off);
+			char *data = (char *)(rec + 1);
+			unsigned int next = off + sizeof(*rec) + JOURNAL_ALIGN(rec->len);
+
+			if (pass == 1 && off >= committed)
+				break;
+			if (rec->magic != JOURNAL_REC_MAGIC || next > JOURNAL_SEGMENT_SIZE ||
+			    (seq != 0 && rec->seq != seq + 1) ||
+			    rec->crc != record_crc(rec, data))
+				break;
+
+			seq = rec->seq;
+			if (rec->group == JOURNAL_GROUP_COMMIT) {
+				if (pass == 0)
+					committed = next;
+			} else if (pass == 1) {
+				func(ctx, rec->group, data, rec->len);
+			}
+			off = next;
+		}
+		if (pass == 0 && seq >= _seq)
+			_seq = seq + 1;
+	}
+
+	return committed;
+}
+
+/**
+ * @function	int Replay(ReplayFunc func, void *ctx)
+ * @brief	按启用顺序回放两个段中完整提交的记录
+ * @return	回放的段中是否有记录: 1有，0无
+ */
+int ParamJournal::Replay(ReplayFunc func, void *ctx)
+{
+	int first = _seg[0].epoch <= _seg[1].epoch ? 0 : 1;
+	int found = 0;
+
+	for (int i = 0; i < 2; i++) {
+		struct Segment *seg = &_seg[first ^ i];
+		if (seg->epoch == 0)
+			continue;
+		if (Scan(seg, func, ctx) > (int)sizeof(struct journal_header))
+			found = 1;
+	}
+
+	return found;
+}
+
+int ParamJournal::InitSegment(struct Segment *seg, unsigned int epoch)
+{
+	memset(seg->base, 0, JOURNAL_SEGMENT_SIZE);
+
+	struct journal_header *head = (struct journal_header *)seg->base;
+	head->magic = JOURNAL_SEG_MAGIC;
+	head->epoch = epoch;
+	head->reserved = 0;
+	head->crc = crc32c(0, head, offsetof(struct journal_header, crc));
+
+	seg->epoch = epoch;
+	seg->tail = sizeof(struct journal_header);
+	seg->synced = seg->tail;
+	return SyncSegment(seg, 0, JOURNAL_SEGMENT_SIZE);
+}
+
+/**
+ * @function	int Reset()
+ * @brief	回放内容已写入快照后清空两个段，从段0重新开始
+ * @return	0成功，-1同步失败
+ */
+int ParamJournal::Reset()
+{
+	unsigned int epoch = _seg[0].epoch > _seg[1].epoch ? _seg[0].epoch : _seg[1].epoch;
+	int ret = InitSegment(&_seg[1], 0);
+	if (InitSegment(&_seg[0], epoch + 1) < 0)
+		ret = -1;
+	_active = 0;
+	_pending = false;
+	return ret;
+}
+
+int ParamJournal::Write(int group, const void *data, unsigned int len)
+{
+	struct Segment *seg = &_seg[_active];
+	unsigned int next = seg->tail + sizeof(struct journal_record) + JOURNAL_ALIGN(len);
+	if (seg->base == NULL || next > JOURNAL_SEGMENT_SIZE)
+		return -1;
+
+	struct journal_record *rec = (struct journal_record *)(seg->base + seg->tail);
+	memcpy(rec + 1, data, len);
+	rec->group = group;
+	rec->len   = len;
+	rec->seq   = _seq++;
+	rec->crc   = record_crc(rec, rec + 1);
+	rec->magic = JOURNAL_REC_MAGIC;
+	seg->tail  = next;
+	return 0;
+}
+
+/**
+ * @function	int Append(int group, const void *data, unsigned int len)
+ * @brief	追加一条参数记录，只写入映射内存，Commit时统一落盘
+ * @return	0成功，-1段已满
+ */
+int ParamJournal::Append(int group, const void *data, unsigned int len)
+{
+	//提交记录需预留空间
+	struct Segment *seg = &_seg[_active];
+	if (seg->tail + 2 * sizeof(struct journal_record) + JOURNAL_ALIGN(len) >
+	    JOURNAL_SEGMENT_SIZE)
+		return -1;
+
+	if (Write(group, data, len) < 0)
+		return -1;
+
+	_pending = true;
+	return 0;
+}
+
+/**
+ * @function	int Commit()
+ * @brief	写入提交记录，并对本批记录做一次msync
+ * @return	0成功，-1本批未能落盘(之后由快照保存)
+ */
+int ParamJournal::Commit()
+{
+	if (!_pending)
+		return 0;
+
+	//失败时也结束本批，未提交的记录回放时丢弃，同步失败的范围由下一批重新同步
+	struct Segment *seg = &_seg[_active];
+	_pending = false;
+	if (Write(JOURNAL_GROUP_COMMIT, NULL, 0) < 0)
+		return -1;
+
+	if (SyncSegment(seg, seg->synced, seg->tail) < 0)
+		return -1;
+	seg->synced = seg->tail;
+	return 0;
+}
+
+/* 一条len字节数据的记录在段中占用的空间 */
+unsigned int ParamJournal::RecordSize(unsigned int len)
+{
+	return sizeof(struct journal_record) + JOURNAL_ALIGN(len);
+}
+
+/**
+ * @function	bool Fits(unsigned int bytes) const
+ * @brief	当前段能否再写入bytes字节的记录及其提交记录，
+ *		bytes为各条记录RecordSize()之和
+ *
+ */
+bool ParamJournal::Fits(unsigned int bytes) const
+{
+	return _seg[_active].tail + bytes + sizeof(struct journal_record) <=
+		JOURNAL_SEGMENT_SIZE;
+}
+
+bool ParamJournal::Empty() const
+{
+	return _seg[_active].tail == sizeof(struct journal_header);
+}
+
+unsigned int ParamJournal::Usage() const
+{
+	return _seg[_active].tail;
+}
+
+/**
+ * @function	int Switch()
+ * @brief	切换到另一个(已清空的)段继续追加，旧段待快照完成后清空
+ * @return	旧段序号
+ */
+int ParamJournal::Switch()
+{
+	int old = _active;
+	_active ^= 1;
+	if (InitSegment(&_seg[_active], _seg[old].epoch + 1) < 0)
+		Debug("init parameter journal segment %d failed", _active);
+	return old;
+}
+
+/**
+ * @function	int Clear(int index)
+ * @brief	快照已保存，丢弃该段中的记录
+ * @return	0成功，-1同步失败
+ */
+int ParamJournal::Clear(int index)
+{
+	return InitSegment(&_seg[index], 0);
+}
@@ -0,0 +1,80 @@
+/**
+ * @file	param_journal.h
+ * @brief	参数日志类声明
+ * @author	agent <agent@local>
+ * @version	1.0.0
+ * @date	2026-10-16
+ *
+ * @verbatim
+ * ============================================================================
+ * Copyright (c) Shenzhen Landun technology Co.,Ltd. 2026
+ * All rights reserved. 
+ * 
+ * Use of this software is controlled by the terms and conditions found in the
+ * license agreenment under which this software has been supplied or provided.
+ * ============================================================================
+ * 
+ * @endverbatim
+ * 
+ */
+
+
+#ifndef _PARAMJOURNAL_H_
+#define _PARAMJOURNAL_H_
+
+#define JOURNAL_PATH		"/data/param.journal"
+#define JOURNAL_SEGMENT_SIZE	(32 * 1024)
+
+/**
+ * 追加写的参数日志，由两个mmap映射的段文件(<path>.0/<path>.1)轮换使用。
+ * 每条记录带序号和CRC32C，一批记录以提交记录结尾并只同步一次；
+ * 回放时只应用完整提交的批次，掉电截断的尾部被丢弃。
+ */
+class ParamJournal
+{
+
+public:
+	typedef void (*ReplayFunc)(void *ctx, int group, const void *data,
+				   unsigned int len);
+
+	ParamJournal();
+	~ParamJournal();
+
+	int  Open(const char *path);
+	void Close();
+	int  Replay(ReplayFunc func, void *ctx);
+	int  Reset();
+
+	int  Append(int group, const void *data, unsigned int len);
+	bool Fits(unsigned int bytes) const;
+	static unsigned int RecordSize(unsigned int len);
+	int  Commit();
+	bool Pending() const { return _pending; }
+	bool Empty() const;
+	unsigned int Usage() const;
+
+	int  Switch();
+	int  Clear(int index);
+
+private:
+	struct Segment {
+		int  fd;
+		char *base;
+		unsigned int epoch;	//段的启用顺序，回放时先旧后新
+		unsigned int tail;	//下一条记录的写入位置
+		unsigned int synced;	//已msync的位置
+	};
+
+	struct Segment _seg[2];
+	int  _active;
+	unsigned int _seq;	//下一条记录的序号，跨段连续
+	bool _pending;		//有未提交的记录
+
+	int  OpenSegment(struct Segment *seg, const char *path);
+	int  Write(int group, const void *data, unsigned int len);
+	int  Scan(struct Segment *seg, ReplayFunc func, void *ctx);
+	int  InitSegment(struct Segment *seg, unsigned int epoch);
+	int  SyncSegment(struct Segment *seg, unsigned int from, unsigned int to);
+};
+
+#endif
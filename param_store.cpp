@@ -0,0 +1,622 @@
+/**
+ * @file	param_store.cpp
+ * @brief	参数存储类实现
+ * @author	agent <agent@local>
+ * @version 	1.0.0
+ * @date 	2026-10-16
+ *
+ * @verbatim
+ * ============================================================================
+ * Copyright (c) Shenzhen Landun technology Co.,Ltd. 2026
+ * All rights reserved. 
+ * 
+ * Use of this software is controlled by the terms and conditions found in the
+ * license agreenment under which this software has been supplied or provided.
+ * ============================================================================
+ * 
+ * @endverbatim
+ * 
+ */
+
+
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sched.h>
+#include "debug.h"
+#include "parameters.h"
+#include "param_store.h"
+
+
+ParamStore *ParamStore::GetInstance()
+{
+	static ParamStore instance;
+	return &instance;
+}
+
+/* 修改计数的起始值每次启动不同，避免客户端把重启前的计数误认为当前值 */
+static unsigned int generation_seed()
+{
+	unsigned int seed = 0;
+	int fd = open("/dev/urandom", O_RDONLY | O_CLOEXEC);
+	if (fd >= 0) {
+		ssize_t ret = read(fd, &seed, sizeof(seed));
+		ret = ret;
+		close(fd);
+	}
+
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	seed ^= (unsigned int)now.tv_nsec ^ ((unsigned int)getpid() << 16);
+
+	//留出余量，运行期间不回绕到0
+	return (seed & 0x7FFFFFFF) | 1;
+}
+
+ParamStore::ParamStore()
+{
+	memset(&_cur, 0, sizeof(_cur));
+	unsigned int seed = generation_seed();
+	for (int i = 0; i < PARAM_GROUP_NUM; i++)
+		_gen[i] = seed;
+	_seq = 0;
+	_dirty = 0;
+	_loaded = false;
+	_journal_ok = false;
+	_quit = false;
+	_started = false;
+	_urgent = false;
+	_compacting = false;
+	memset(&_snapshot, 0, sizeof(_snapshot));
+	_snapshot_groups = 0;
+	_snapshot_segment = 0;
+	memset(&_last_commit, 0, sizeof(_last_commit));
+
+	pthread_mutex_init(&_lock, NULL);
+	pthread_mutex_init(&_params_lock, NULL);
+	pthread_condattr_t attr;
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&_cond, &attr);
+	pthread_condattr_destroy(&attr);
+}
+
+ParamStore::~ParamStore()
+{
+	pthread_cond_destroy(&_cond);
+	pthread_mutex_destroy(&_params_lock);
+	pthread_mutex_destroy(&_lock);
+}
+
+unsigned int ParamStore::GroupSize(int group)
+{
+	switch (group) {
+	case PARAM_GROUP_CAMERA:
+		return sizeof(CameraParam);
+	case PARAM_GROUP_NETWORK:
+		return sizeof(NetworkParam);
+	case PARAM_GROUP_UPLOAD:
+		return sizeof(UploadParam);
+	case PARAM_GROUP_FLASH:
+		return sizeof(FlashParam);
+	case PARAM_GROUP_DEVICE_INFO:
+		return sizeof(DeviceInfo);
+	case PARAM_GROUP_TRAFFIC:
+		return sizeof(TrafficParam);
+	default:
+		break;
+	}
+
+	return 0;
+}
+
+void *ParamStore::Field(struct ParamValues *values, int group)
+{
+	switch (group) {
+	case PARAM_GROUP_CAMERA:
+		return &values->camera;
+	case PARAM_GROUP_NETWORK:
+		return &values->network;
+	case PARAM_GROUP_UPLOAD:
+		return &values->upload;
+	case PARAM_GROUP_FLASH:
+		return &values->flash;
+	case PARAM_GROUP_DEVICE_INFO:
+		return &values->device_info;
+	case PARAM_GROUP_TRAFFIC:
+		return &values->traffic;
+	default:
+		break;
+	}
+
+	return NULL;
+}
+
+void ParamStore::ReplayRecord(void *ctx, int group, const void *data,
+			      unsigned int len)
+{
+	ParamStore *store = (ParamStore *)ctx;
+	void *field = store->Field(&store->_cur, group);
+	if (field == NULL || group == PARAM_GROUP_TRAFFIC || len != GroupSize(group))
+		return;
+
+	memcpy(field, data, len);
+	store->_dirty |= 1 << group;
+}
+
+/**
+ * @function	void SaveSnapshot(const struct ParamValues *values, unsigned int groups)
+ * @brief	把指定参数组写入Parameters的持久化存储
+ *
+ */
+void ParamStore::SaveSnapshot(const struct ParamValues *values, unsigned int groups)
+{
+	Parameters *params = Parameters::GetInstance();
+	struct ParamValues copy = *values;
+
+	pthread_mutex_lock(&_params_lock);
+	if (groups & (1 << PARAM_GROUP_CAMERA))
+		params->SetCameraParam(&copy.camera);
+	if (groups & (1 << PARAM_GROUP_NETWORK))
+		params->SetNetworkParam(&copy.network);
+	if (groups & (1 << PARAM_GROUP_UPLOAD))
+		params->SetUploadParam(&copy.upload);
+	if (groups & (1 << PARAM_GROUP_FLASH))
+		params->SetFlashParam(&copy.flash);
+	if (groups & (1 << PARAM_GROUP_DEVICE_INFO))
+		params->SetDeviceInfo(&copy.device_info);
+	pthread_mutex_unlock(&_params_lock);
+}
+
+/**
+ * @function	int Load()
+ * @brief	从Parameters读取参数并回放日志中已提交的修改，
+ *		有回放内容时先写入快照再清空日志，然后启动后台快照线程
+ *
+ */
+int ParamStore::Load()
+{
+	if (_loaded)
+		return 0;
+
+	Parameters *params = Parameters::GetInstance();
+	_cur.camera	 = params->GetCameraParam();
+	_cur.network	 = params->GetNetworkParam();
+	_cur.upload	 = params->GetUploadParam();
+	_cur.flash	 = params->GetFlashParam();
+	_cur.device_info = params->GetDeviceInfo();
+	_cur.traffic	 = params->GetTrafficParam();
+
+	_journal_ok = _journal.Open(JOURNAL_PATH) == 0;
+	if (_journal_ok) {
+		if (_journal.Replay(ReplayRecord, this)) {
+			Debug("replay parameter journal, groups 0x%x", _dirty);
+			SaveSnapshot(&_cur, _dirty);
+		}
+		if (_journal.Reset() < 0) {
+			_journal.Close();
+			_journal_ok = false;
+		}
+	}
+	if (!_journal_ok)
+		Debug("parameter journal unavailable, save directly");
+	_dirty = 0;
+	_loaded = true;
+
+	if (_journal_ok) {
+		_started = true;
+		Start();
+	}
+	return 0;
+}
+
+/**
+ * @function	void Shutdown()
+ * @brief	通知后台线程退出，并等待其提交日志、写完最后一次快照，可重复调用
+ *
+ */
+void ParamStore::Shutdown()
+{
+	pthread_mutex_lock(&_lock);
+	_quit = true;
+	pthread_cond_broadcast(&_cond);
+	while (_started)
+		pthread_cond_wait(&_cond, &_lock);
+	pthread_mutex_unlock(&_lock);
+}
+
+/* 等待进行中的修改完成，返回开始读取时的序号 */
+unsigned int ParamStore::ReadBegin() const
+{
+	unsigned int seq;
+	while ((seq = _seq) & 1)
+		sched_yield();
+	__sync_synchronize();
+	return seq;
+}
+
+/* 读取期间有修改时返回true，需重读 */
+bool ParamStore::ReadRetry(unsigned int seq) const
+{
+	__sync_synchronize();
+	return _seq != seq;
+}
+
+/**
+ * @function	void GetAll(struct ParamValues *values, unsigned int *gen)
+ * @brief	取所有参数组在同一时刻的副本，gen不为NULL时返回各组修改计数之和，
+ *		任一组修改后都会变化
+ *
+ */
+void ParamStore::GetAll(struct ParamValues *values, unsigned int *gen)
+{
+	RefreshExternal();
+
+	unsigned int seq;
+	do {
+		seq = ReadBegin();
+		memcpy(values, (const void *)&_cur, sizeof(*values));
+		if (gen != NULL)
+			*gen = SumGenerations();
+	} while (ReadRetry(seq));
+}
+
+unsigned int ParamStore::SumGenerations() const
+{
+	unsigned int gen = 0;
+	for (int i = 0; i < PARAM_GROUP_NUM; i++)
+		gen += _gen[i];
+	return gen;
+}
+
+unsigned int ParamStore::GenerationAll()
+{
+	RefreshExternal();
+	return SumGenerations();
+}
+
+unsigned int ParamStore::Generation(int group)
+{
+	if (PARAM_GROUPS_EXTERNAL & (1 << group))
+		RefreshExternal();
+	return _gen[group];
+}
+
+/**
+ * @function	void RefreshExternal()
+ * @brief	从Parameters重新读取PARAM_GROUPS_EXTERNAL中的参数组，
+ *		内容有变化时更新并递增修改计数，未变化时不加锁
+ *
+ */
+void ParamStore::RefreshExternal()
+{
+	pthread_mutex_lock(&_params_lock);
+	TrafficParam traffic = Parameters::GetInstance()->GetTrafficParam();
+	pthread_mutex_unlock(&_params_lock);
+	if (memcmp(&traffic, (const void *)&_cur.traffic, sizeof(traffic)) == 0)
+		return;
+
+	pthread_mutex_lock(&_lock);
+	if (memcmp(&traffic, &_cur.traffic, sizeof(traffic)) != 0) {
+		__sync_add_and_fetch(&_seq, 1);
+		_cur.traffic = traffic;
+		__sync_add_and_fetch(&_gen[PARAM_GROUP_TRAFFIC], 1);
+		__sync_add_and_fetch(&_seq, 1);
+	}
+	pthread_mutex_unlock(&_lock);
+}
+
+/**
+ * @function	int Get(int group, void *data, unsigned int *gen)
+ * @brief	取一个参数组，gen不为NULL时同时返回与数据对应的修改计数
+ *
+ */
+int ParamStore::Get(int group, void *data, unsigned int *gen)
+{
+	void *field = Field(&_cur, group);
+	if (field == NULL)
+		return -1;
+
+	if (PARAM_GROUPS_EXTERNAL & (1 << group))
+		RefreshExternal();
+
+	unsigned int seq;
+	do {
+		seq = ReadBegin();
+		memcpy(data, field, GroupSize(group));
+		if (gen != NULL)
+			*gen = _gen[group];
+	} while (ReadRetry(seq));
+
+	return 0;
+}
+
+/**
+ * @function	int Set(int group, const void *data)
+ * @brief	更新内存中的参数组并追加日志记录，Commit后才落盘
+ *
+ */
+int ParamStore::Set(int group, const void *data)
+{
+	struct ParamValues values;
+	void *field = Field(&values, group);
+	if (field == NULL)
+		return -1;
+
+	memcpy(field, data, GroupSize(group));
+	return SetAll(&values, 1 << group);
+}
+
+/**
+ * @function	int SetAll(const struct ParamValues *values, unsigned int groups)
+ * @brief	在同一把锁内更新groups中的各参数组，其他线程不会看到一半的修改；
+ *		日志记录属于同一批提交，回放时同时生效。写入前先为全部记录预留空间，
+ *		不会只提交其中一部分
+ *
+ */
+int ParamStore::SetAll(const struct ParamValues *values, unsigned int groups)
+{
+	groups &= ~(1U << PARAM_GROUP_TRAFFIC);
+	groups &= (1U << PARAM_GROUP_NUM) - 1;
+	if (groups == 0)
+		return -1;
+
+	unsigned int need = 0;
+	for (int group = 0; group < PARAM_GROUP_NUM; group++) {
+		if (groups & (1 << group))
+			need += ParamJournal::RecordSize(GroupSize(group));
+	}
+
+	pthread_mutex_lock(&_lock);
+	bool direct = !_journal_ok;
+	if (!direct && !_journal.Fits(need)) {
+		//当前段放不下整个事务(后台快照未跟上): 提交之前已完整的记录并切换到另一段，
+		//旧段由后台线程写快照后清空，本事务的记录全部写入新段。
+		//另一段仍在写快照时回复失败，不在reactor中等待
+		if (_journal.Commit() < 0)
+			_urgent = true;
+		if (!BeginCompact() || !_journal.Fits(need)) {
+			pthread_mutex_unlock(&_lock);
+			Debug("parameter journal full, groups 0x%x rejected", groups);
+			return -1;
+		}
+		pthread_cond_broadcast(&_cond);
+	}
+
+	__sync_add_and_fetch(&_seq, 1);
+	for (int group = 0; group < PARAM_GROUP_NUM; group++) {
+		if (!(groups & (1 << group)))
+			continue;
+		memcpy(Field(&_cur, group), Field((struct ParamValues *)values, group),
+		       GroupSize(group));
+		//数据写完后再递增，不加锁读Generation()的一方看到新值时数据已更新
+		__sync_add_and_fetch(&_gen[group], 1);
+	}
+	__sync_add_and_fetch(&_seq, 1);
+	_dirty |= groups;
+
+	if (direct) {
+		struct ParamValues copy = _cur;
+		_dirty &= ~groups;
+		pthread_mutex_unlock(&_lock);
+		SaveSnapshot(&copy, groups);
+		return 0;
+	}
+
+	//空间已预留，Append不应失败；失败时内存中的修改由后台线程立即写入快照
+	int ret = 0;
+	for (int group = 0; group < PARAM_GROUP_NUM; group++) {
+		if (!(groups & (1 << group)))
+			continue;
+		if (_journal.Append(group, Field((struct ParamValues *)values, group),
+				    GroupSize(group)) < 0)
+			ret = -1;
+	}
+	if (ret < 0) {
+		Debug("append parameter journal failed, groups 0x%x", groups);
+		_urgent = true;
+		pthread_cond_broadcast(&_cond);
+	}
+	pthread_mutex_unlock(&_lock);
+	return ret;
+}
+
+/**
+ * @function	int Commit()
+ * @brief	提交本批设置，整批只msync一次；回放时整批要么全部生效要么全部丢弃。
+ *		应答已在发送缓冲中，失败时由后台线程立即写快照保存本批设置
+ * @return	0成功，-1日志落盘失败
+ */
+int ParamStore::Commit()
+{
+	if (!_journal_ok)
+		return 0;
+
+	pthread_mutex_lock(&_lock);
+	int ret = 0;
+	if (_journal.Pending()) {
+		ret = _journal.Commit();
+		clock_gettime(CLOCK_MONOTONIC, &_last_commit);
+		if (ret < 0 || _journal.Usage() > JOURNAL_SEGMENT_SIZE / 2)
+			_urgent = true;
+		pthread_cond_broadcast(&_cond);
+	}
+	pthread_mutex_unlock(&_lock);
+
+	if (ret < 0)
+		Debug("commit parameter journal failed, save snapshot now");
+	return ret;
+}
+
+/**
+ * @function	bool BeginCompact()
+ * @brief	切换到另一段，记录待写入的快照，调用时持有_lock；
+ *		切换后新的设置不受影响，旧段在快照写完后清空，
+ *		写快照时掉电，重启回放旧段即可恢复
+ * @return	true已切换，需调用FinishCompact
+ */
+bool ParamStore::BeginCompact()
+{
+	if (_journal.Empty() || _journal.Pending() || _compacting)
+		return false;
+
+	_snapshot = _cur;
+	_snapshot_groups = _dirty;
+	_dirty = 0;
+	_urgent = false;
+	_snapshot_segment = _journal.Switch();
+	_compacting = true;
+	return true;
+}
+
+/**
+ * @function	void FinishCompact()
+ * @brief	写入快照并清空旧段，只在后台线程中调用，持有_lock，写快照期间释放
+ *
+ */
+void ParamStore::FinishCompact()
+{
+	pthread_mutex_unlock(&_lock);
+	SaveSnapshot(&_snapshot, _snapshot_groups);
+	pthread_mutex_lock(&_lock);
+
+	if (_journal.Clear(_snapshot_segment) < 0)
+		Debug("clear parameter journal segment %d failed", _snapshot_segment);
+	_compacting = false;
+	pthread_cond_broadcast(&_cond);
+}
+
+/* 写入快照并清空日志，调用时持有_lock */
+void ParamStore::Compact()
+{
+	if (BeginCompact())
+		FinishCompact();
+}
+
+/**
+ * @function	void Run()
+ * @brief	后台快照线程: 日志过半立即快照，否则等待COMPACT_IDLE_MS无新提交
+ *
+ */
+void ParamStore::Run()
+{
+	pthread_mutex_lock(&_lock);
+	while (!_quit && !IsTerminated()) {
+		//reactor因当前段已满切换了段，旧段待写快照
+		if (_compacting) {
+			FinishCompact();
+			continue;
+		}
+
+		if (_journal.Empty()) {
+			pthread_cond_wait(&_cond, &_lock);
+			continue;
+		}
+
+		struct timespec deadline = _last_commit;
+		deadline.tv_sec  += COMPACT_IDLE_MS / 1000;
+		deadline.tv_nsec += (COMPACT_IDLE_MS % 1000) * 1000000;
+		if (deadline.tv_nsec >= 1000000000) {
+			deadline.tv_sec++;
+			deadline.tv_nsec -= 1000000000;
+		}
+
+		struct timespec now;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		bool idle = now.tv_sec > deadline.tv_sec ||
+			(now.tv_sec == deadline.tv_sec && now.tv_nsec >= deadline.tv_nsec);
+		if (!_urgent && !idle) {
+			pthread_cond_timedwait(&_cond, &_lock, &deadline);
+			continue;
+		}
+
+		if (_journal.Pending()) {
+			//reactor正在处理一批设置，稍后再试
+			now.tv_nsec += 10 * 1000000;
+			if (now.tv_nsec >= 1000000000) {
+				now.tv_sec++;
+				now.tv_nsec -= 1000000000;
+			}
+			pthread_cond_timedwait(&_cond, &_lock, &now);
+			continue;
+		}
+
+		Compact();
+	}
+
+	if (_compacting)
+		FinishCompact();
+	_journal.Commit();
+	Compact();
+	_started = false;
+	pthread_cond_broadcast(&_cond);
+	pthread_mutex_unlock(&_lock);
+}
+
+CameraParam ParamStore::GetCameraParam()
+{
+	CameraParam param;
+	Get(PARAM_GROUP_CAMERA, &param);
+	return param;
+}
+
+NetworkParam ParamStore::GetNetworkParam()
+{
+	NetworkParam param;
+	Get(PARAM_GROUP_NETWORK, &param);
+	return param;
+}
+
+UploadParam ParamStore::GetUploadParam()
+{
+	UploadParam param;
+	Get(PARAM_GROUP_UPLOAD, &param);
+	return param;
+}
+
+FlashParam ParamStore::GetFlashParam()
+{
+	FlashParam param;
+	Get(PARAM_GROUP_FLASH, &param);
+	return param;
+}
+
+DeviceInfo ParamStore::GetDeviceInfo()
+{
+	DeviceInfo param;
+	Get(PARAM_GROUP_DEVICE_INFO, &param);
+	return param;
+}
+
+TrafficParam ParamStore::GetTrafficParam()
+{
+	TrafficParam param;
+	Get(PARAM_GROUP_TRAFFIC, &param);
+	return param;
+}
+
+int ParamStore::SetCameraParam(const CameraParam *param)
+{
+	return Set(PARAM_GROUP_CAMERA, param);
+}
+
+int ParamStore::SetNetworkParam(const NetworkParam *param)
+{
+	return Set(PARAM_GROUP_NETWORK, param);
+}
+
+int ParamStore::SetUploadParam(const UploadParam *param)
+{
+	return Set(PARAM_GROUP_UPLOAD, param);
+}
+
+int ParamStore::SetFlashParam(const FlashParam *param)
+{
+	return Set(PARAM_GROUP_FLASH, param);
+}
+
+int ParamStore::SetDeviceInfo(const DeviceInfo *param)
+{
+	return Set(PARAM_GROUP_DEVICE_INFO, param);
+}
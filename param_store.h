@@ -0,0 +1,136 @@
+/**
+ * @file	param_store.h
+ * @brief	参数存储类声明
+ * @author	agent <agent@local>
+ * @version	1.0.0
+ * @date	2026-10-16
+ *
+ * @verbatim
+ * ============================================================================
+ * Copyright (c) Shenzhen Landun technology Co.,Ltd. 2026
+ * All rights reserved. 
+ * 
+ * Use of this software is controlled by the terms and conditions found in the
+ * license agreenment under which this software has been supplied or provided.
+ * ============================================================================
+ * 
+ * @endverbatim
+ * 
+ */
+
+
+#ifndef _PARAMSTORE_H_
+#define _PARAMSTORE_H_
+
+#include <pthread.h>
+#include "thread.h"
+#include "ldczn_protocol.h"
+#include "param_journal.h"
+
+/* 参数组 */
+#define PARAM_GROUP_CAMERA	0
+#define PARAM_GROUP_NETWORK	1
+#define PARAM_GROUP_UPLOAD	2
+#define PARAM_GROUP_FLASH	3
+#define PARAM_GROUP_DEVICE_INFO	4
+#define PARAM_GROUP_TRAFFIC	5	//只读
+#define PARAM_GROUP_NUM		6
+
+/* 由其他模块通过Parameters维护的参数组，每次读取时重新取 */
+#define PARAM_GROUPS_EXTERNAL	(1 << PARAM_GROUP_TRAFFIC)
+
+#define COMPACT_IDLE_MS		1000	//无新提交多久后写入快照
+
+struct ParamValues {
+	CameraParam	camera;
+	NetworkParam	network;
+	UploadParam	upload;
+	FlashParam	flash;
+	DeviceInfo	device_info;
+	TrafficParam	traffic;
+};
+
+/**
+ * TCP服务的参数视图。设置先写入内存和参数日志(ParamJournal)，
+ * 每批请求只同步一次日志；后台线程在空闲或日志过半时把变化的参数组
+ * 通过Parameters::Set*Param写入快照并清空日志。
+ * 读取不加锁: 写者持_lock并在修改前后递增_seq，读者拷贝期间_seq有变化则重读，
+ * 多个reactor线程查询参数互不阻塞。
+ * camera/network/upload/flash/device_info以本类为准，启动时读取一次，
+ * 其他模块须通过本类修改，直接调用Parameters::Set*的修改在重启前不会生效；
+ * PARAM_GROUPS_EXTERNAL中的组以Parameters为准，每次查询时重新读取，
+ * 内容变化时递增修改计数。
+ */
+class ParamStore: public Thread
+{
+
+public:
+	static ParamStore *GetInstance();
+
+	int  Load();
+	void Shutdown();
+
+	CameraParam  GetCameraParam();
+	NetworkParam GetNetworkParam();
+	UploadParam  GetUploadParam();
+	FlashParam   GetFlashParam();
+	DeviceInfo   GetDeviceInfo();
+	TrafficParam GetTrafficParam();
+
+	int  SetCameraParam(const CameraParam *param);
+	int  SetNetworkParam(const NetworkParam *param);
+	int  SetUploadParam(const UploadParam *param);
+	int  SetFlashParam(const FlashParam *param);
+	int  SetDeviceInfo(const DeviceInfo *param);
+
+	int  Get(int group, void *data, unsigned int *gen = NULL);
+	void GetAll(struct ParamValues *values, unsigned int *gen = NULL);
+	int  Set(int group, const void *data);
+	int  SetAll(const struct ParamValues *values, unsigned int groups);
+	int  Commit();
+	unsigned int Generation(int group);
+	unsigned int GenerationAll();
+
+	static unsigned int GroupSize(int group);
+	static void *Field(struct ParamValues *values, int group);
+
+protected:
+	void Run();
+
+private:
+	ParamStore();
+	~ParamStore();
+
+	struct ParamValues _cur;		//当前参数
+	volatile unsigned int _gen[PARAM_GROUP_NUM];	//各组修改计数，Set时递增
+	volatile unsigned int _seq;	//_cur修改中为奇数
+	unsigned int _dirty;		//自上次快照后变化的参数组
+	ParamJournal _journal;
+	bool _loaded;
+	bool _journal_ok;		//日志不可用时直接写Parameters
+	bool _quit;
+	bool _started;			//后台线程运行中，退出前写完最后一次快照
+	bool _urgent;			//日志过半，立即快照
+	bool _compacting;		//已切换日志段，后台正在或即将写快照
+	struct ParamValues _snapshot;	//切换段时的参数，写入快照后清空旧段
+	unsigned int _snapshot_groups;
+	int  _snapshot_segment;
+	struct timespec _last_commit;
+
+	pthread_mutex_t _lock;
+	pthread_cond_t  _cond;
+	pthread_mutex_t _params_lock;	//Parameters非线程安全: 各分片读取交通参数，快照线程写入
+
+	unsigned int SumGenerations() const;
+	void RefreshExternal();
+	unsigned int ReadBegin() const;
+	bool ReadRetry(unsigned int seq) const;
+	void SaveSnapshot(const struct ParamValues *values, unsigned int groups);
+	bool BeginCompact();
+	void FinishCompact();
+	void Compact();
+	static void ReplayRecord(void *ctx, int group, const void *data,
+				 unsigned int len);
+};
+
+#endif
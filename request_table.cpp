@@ -0,0 +1,108 @@
+/**
+ * @file	request_table.cpp
+ * @brief	请求分发表类实现
+ * @author	agent <agent@local>
+ * @version 	1.0.0
+ * @date 	2026-10-16
+ *
+ * @verbatim
+ * ============================================================================
+ * Copyright (c) Shenzhen Landun technology Co.,Ltd. 2026
+ * All rights reserved. 
+ * 
+ * Use of this software is controlled by the terms and conditions found in the
+ * license agreenment under which this software has been supplied or provided.
+ * ============================================================================
+ * 
+ * @endverbatim
+ * 
+ */
+
+
+#include <string.h>
+#include "debug.h"
+#include "request_table.h"
+
+
+RequestTable::RequestTable()
+{
+	memset(_index, 0, sizeof(_index));
+	memset(_any, 0, sizeof(_any));
+	memset(_next, 0, sizeof(_next));
+	memset(_handlers, 0, sizeof(_handlers));
+	memset(_stats, 0, sizeof(_stats));
+	_count = 0;
+	_unknown = 0;
+}
+
+bool RequestTable::Matches(const struct RequestHandler *handler, unsigned int type)
+{
+	return (type & handler->cmd_mask) == handler->cmd;
+}
+
+/**
+ * @function	int Register(const struct RequestHandler *handler)
+ * @brief	注册一个处理项，处理项由调用者保存，须在reactor运行前注册
+ * @return	处理项索引，-1主类型超出范围、表已满或与已有项重复
+ */
+int RequestTable::Register(const struct RequestHandler *handler)
+{
+	unsigned int major = REQ_MAJOR(handler->type);
+	unsigned int sub = REQ_SUB(handler->type);
+	if (major >= REQ_TABLE_MAJORS || _count >= REQ_HANDLER_MAX) {
+		Debug("request table: cannot register %s", handler->name);
+		return -1;
+	}
+
+	unsigned char *slot = (handler->flags & REQ_FLAG_ANY_SUB) ?
+			      &_any[major] : &_index[major][sub];
+	while (*slot != 0) {
+		const struct RequestHandler *h = _handlers[*slot];
+		if (h->cmd_mask == handler->cmd_mask && h->cmd == handler->cmd) {
+			Debug("request table: %s conflicts with %s",
+			      handler->name, h->name);
+			return -1;
+		}
+		slot = &_next[*slot];
+	}
+
+	int index = ++_count;
+	_handlers[index] = handler;
+	*slot = index;
+	return index;
+}
+
+/* 依次注册到name为NULL的结束项，返回成功注册的个数 */
+int RequestTable::RegisterAll(const struct RequestHandler *handlers)
+{
+	int n = 0;
+	for (; handlers->name != NULL; handlers++) {
+		if (Register(handlers) > 0)
+			n++;
+	}
+	return n;
+}
+
+/**
+ * @function	int Lookup(unsigned int type) const
+ * @brief	按请求类型查找处理项，先查子类型，再查主类型的通配项
+ * @return	处理项索引，0为未注册
+ */
+int RequestTable::Lookup(unsigned int type) const
+{
+	unsigned int major = REQ_MAJOR(type);
+	if (major >= REQ_TABLE_MAJORS)
+		return 0;
+
+	int index = _index[major][REQ_SUB(type)];
+	for (; index != 0; index = _next[index]) {
+		if (Matches(_handlers[index], type))
+			return index;
+	}
+
+	for (index = _any[major]; index != 0; index = _next[index]) {
+		if (Matches(_handlers[index], type))
+			return index;
+	}
+	return 0;
+}
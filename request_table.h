@@ -0,0 +1,99 @@
+/**
+ * @file	request_table.h
+ * @brief	请求分发表类声明
+ * @author	agent <agent@local>
+ * @version	1.0.0
+ * @date	2026-10-16
+ *
+ * @verbatim
+ * ============================================================================
+ * Copyright (c) Shenzhen Landun technology Co.,Ltd. 2026
+ * All rights reserved. 
+ * 
+ * Use of this software is controlled by the terms and conditions found in the
+ * license agreenment under which this software has been supplied or provided.
+ * ============================================================================
+ * 
+ * @endverbatim
+ * 
+ */
+
+
+#ifndef _REQUESTTABLE_H_
+#define _REQUESTTABLE_H_
+
+#include "ldczn_protocol.h"
+
+class TcpServer;
+
+typedef int (TcpServer::*RequestFn)(struct payload_req *req, char *buf);
+
+#define REQ_MAJOR(type)		(((type) >> 24) & 0xFF)
+#define REQ_SUB(type)		(((type) >> 16) & 0xFF)
+
+#define REQ_TABLE_MAJORS	16	//主类型取值上限(不含)，REQ_TYPE_SUBSCRIBE为0x0F
+#define REQ_HANDLER_MAX		63	//处理项个数上限，索引0表示无
+
+/* 处理项标志 */
+#define REQ_FLAG_ANY_SUB	0x01	//主类型下其他未注册子类型均由该项处理
+#define REQ_FLAG_ACK		0x02	//处理后回复成功应答，group有效时再发变化通知
+#define REQ_FLAG_CACHED		0x04	//用group的缓存应答回复，不调用fn
+
+/**
+ * 请求处理项: 按req.type的主类型(0xFF000000)和子类型(0x00FF0000)定位，
+ * 同一子类型下可按(type & cmd_mask) == cmd再区分。payload为payload_req之后
+ * 至少需要的字节数，分发时统一检查，处理函数不再检查定长部分。
+ */
+struct RequestHandler {
+	unsigned int	type;		//主类型|子类型
+	unsigned int	cmd_mask;	//0为不区分
+	unsigned int	cmd;
+	unsigned int	payload;
+	int		klass;		//REQ_CLASS_*
+	int		group;		//PARAM_GROUP_*，-1无
+	unsigned int	flags;		//REQ_FLAG_*
+	RequestFn	fn;		//NULL时只按flags应答
+	const char	*name;		//NULL为表的结束项
+};
+
+struct RequestStat {
+	unsigned int calls;		//分发次数
+	unsigned int short_payload;	//负载长度不足被拒绝的次数
+};
+
+/**
+ * 处理项在启动时由静态表注册，查找为两次数组下标，不再逐级switch。
+ * 每个reactor分片一份，计数不加锁，仅由所属reactor线程使用。
+ */
+class RequestTable
+{
+
+public:
+	RequestTable();
+
+	int  Register(const struct RequestHandler *handler);
+	int  RegisterAll(const struct RequestHandler *handlers);
+	int  Lookup(unsigned int type) const;
+
+	const struct RequestHandler *Handler(int index) const { return _handlers[index]; }
+	const struct RequestStat *Stat(int index) const { return &_stats[index]; }
+	int  Count() const { return _count; }
+	unsigned int Unknown() const { return _unknown; }
+
+	void Hit(int index) { _stats[index].calls++; }
+	void Short(int index) { _stats[index].short_payload++; }
+	void Miss() { _unknown++; }
+
+private:
+	unsigned char _index[REQ_TABLE_MAJORS][256];	//(主类型,子类型)到首个处理项
+	unsigned char _any[REQ_TABLE_MAJORS];		//REQ_FLAG_ANY_SUB处理项
+	unsigned char _next[REQ_HANDLER_MAX + 1];	//同一子类型下按cmd区分的后续项
+	const struct RequestHandler *_handlers[REQ_HANDLER_MAX + 1];
+	struct RequestStat _stats[REQ_HANDLER_MAX + 1];
+	int  _count;
+	unsigned int _unknown;		//未注册类型的请求数
+
+	static bool Matches(const struct RequestHandler *handler, unsigned int type);
+};
+
+#endif
@@ -0,0 +1,184 @@
+/**
+ * @file	sensor_shadow.cpp
+ * @brief	传感器参数影子类实现
+ * @author	agent <agent@local>
+ * @version 	1.0.0
+ * @date 	2026-10-16
+ *
+ * @verbatim
+ * ============================================================================
+ * Copyright (c) Shenzhen Landun technology Co.,Ltd. 2026
+ * All rights reserved. 
+ * 
+ * Use of this software is controlled by the terms and conditions found in the
+ * license agreenment under which this software has been supplied or provided.
+ * ============================================================================
+ * 
+ * @endverbatim
+ * 
+ */
+
+
+#include <string.h>
+#include "sensor.h"
+#include "debug.h"
+#include "sensor_shadow.h"
+
+
+SensorShadow::SensorShadow()
+{
+	memset(&_camera, 0, sizeof(_camera));
+	_valid = 0;
+	pthread_mutex_init(&_lock, NULL);
+}
+
+SensorShadow::~SensorShadow()
+{
+	pthread_mutex_destroy(&_lock);
+}
+
+/**
+ * @function	void Invalidate()
+ * @brief	传感器寄存器可能被重置(如视频/抓拍模式切换)时调用，
+ *		下次设置将完整下发
+ */
+void SensorShadow::Invalidate()
+{
+	_valid = 0;
+}
+
+bool SensorShadow::Changed(unsigned int field, bool differ) const
+{
+	return !(_valid & field) || differ;
+}
+
+void SensorShadow::ApplyAEMode(int aew_mode)
+{
+	switch (aew_mode) {
+	case AEWMODE_DISABLE:
+		Sensor::GetInstance()->SetSensorAEManual();
+		break;
+	case AEWMODE_GAIN:
+		Sensor::GetInstance()->SetSensorAEAuto();
+		Sensor::GetInstance()->SetSensorAEMethod(0x01);
+		break;
+	case AEWMODE_EXP:
+		Sensor::GetInstance()->SetSensorAEAuto();
+		Sensor::GetInstance()->SetSensorAEMethod(0x02);
+		break;
+	case AEWMODE_AUTO:
+		Sensor::GetInstance()->SetSensorAEAuto();
+		Sensor::GetInstance()->SetSensorAEMethod(0x00);
+		break;
+	default:
+		break;
+	}
+}
+
+/**
+ * @function	int ApplyCamera(const CameraParam *setting, unsigned int fields)
+ * @brief	下发fields中与影子值不同的字段，顺序与原完整设置一致
+ * @return	实际下发的字段数
+ */
+int SensorShadow::ApplyCamera(const CameraParam *setting, unsigned int fields)
+{
+	Sensor *sensor = Sensor::GetInstance();
+	unsigned int dirty = 0;
+
+#define CAMERA_DIFF(mask, member) \
+	if ((fields & (mask)) && Changed((mask), _camera.member != setting->member)) \
+		dirty |= (mask)
+
+	CAMERA_DIFF(CAMERA_FIELD_AEW_MODE, aew_mode);
+	CAMERA_DIFF(CAMERA_FIELD_DEFAULT_EXPOSURE, default_exposure);
+	CAMERA_DIFF(CAMERA_FIELD_MIN_EXPOSURE, min_exposure);
+	CAMERA_DIFF(CAMERA_FIELD_MAX_EXPOSURE, max_exposure);
+	CAMERA_DIFF(CAMERA_FIELD_MIN_GAIN, min_gain);
+	CAMERA_DIFF(CAMERA_FIELD_MAX_GAIN, max_gain);
+	CAMERA_DIFF(CAMERA_FIELD_DEFAULT_GAIN, default_gain);
+	CAMERA_DIFF(CAMERA_FIELD_BLUE_GAIN, blue_gain);
+	CAMERA_DIFF(CAMERA_FIELD_RED_GAIN, red_gain);
+	CAMERA_DIFF(CAMERA_FIELD_VIDEO_TARGET, video_target_gray);
+	CAMERA_DIFF(CAMERA_FIELD_CAPTURE_TARGET, trigger_target_gray);
+	CAMERA_DIFF(CAMERA_FIELD_AE_ZONE, ae_zone);
+#undef CAMERA_DIFF
+
+	if (dirty & CAMERA_FIELD_AEW_MODE)
+		ApplyAEMode(setting->aew_mode);
+	if (dirty & CAMERA_FIELD_DEFAULT_EXPOSURE)
+		sensor->SetSensorExposure(setting->default_exposure);
+	if (dirty & CAMERA_FIELD_MIN_EXPOSURE)
+		sensor->SetSensorMinExp(setting->min_exposure);
+	if (dirty & CAMERA_FIELD_MAX_EXPOSURE)
+		sensor->SetSensorMaxExp(setting->max_exposure);
+	if (dirty & CAMERA_FIELD_MIN_GAIN)
+		sensor->SetSensorMinGain(setting->min_gain);
+	if (dirty & CAMERA_FIELD_MAX_GAIN)
+		sensor->SetSensorMaxGain(setting->max_gain);
+	if (dirty & CAMERA_FIELD_DEFAULT_GAIN)
+		sensor->SetSensorGain(setting->default_gain);
+	if (dirty & CAMERA_FIELD_BLUE_GAIN)
+		sensor->SetSensorBgain(setting->blue_gain);
+	if (dirty & CAMERA_FIELD_RED_GAIN)
+		sensor->SetSensorRgain(setting->red_gain);
+	if (dirty & CAMERA_FIELD_VIDEO_TARGET)
+		sensor->SetSensorVideoTargetGray(setting->video_target_gray);
+	if (dirty & CAMERA_FIELD_CAPTURE_TARGET)
+		sensor->SetSensorCaptureTargetGray(setting->trigger_target_gray);
+	if (dirty & CAMERA_FIELD_AE_ZONE)
+		sensor->SetSensorAEZone(setting->ae_zone);
+
+	//只更新本次涉及的字段，其余字段保持与传感器一致的旧值
+#define CAMERA_SYNC(mask, member) \
+	if (fields & (mask)) \
+		_camera.member = setting->member
+
+	CAMERA_SYNC(CAMERA_FIELD_AEW_MODE, aew_mode);
+	CAMERA_SYNC(CAMERA_FIELD_DEFAULT_EXPOSURE, default_exposure);
+	CAMERA_SYNC(CAMERA_FIELD_MIN_EXPOSURE, min_exposure);
+	CAMERA_SYNC(CAMERA_FIELD_MAX_EXPOSURE, max_exposure);
+	CAMERA_SYNC(CAMERA_FIELD_MIN_GAIN, min_gain);
+	CAMERA_SYNC(CAMERA_FIELD_MAX_GAIN, max_gain);
+	CAMERA_SYNC(CAMERA_FIELD_DEFAULT_GAIN, default_gain);
+	CAMERA_SYNC(CAMERA_FIELD_BLUE_GAIN, blue_gain);
+	CAMERA_SYNC(CAMERA_FIELD_RED_GAIN, red_gain);
+	CAMERA_SYNC(CAMERA_FIELD_VIDEO_TARGET, video_target_gray);
+	CAMERA_SYNC(CAMERA_FIELD_CAPTURE_TARGET, trigger_target_gray);
+	CAMERA_SYNC(CAMERA_FIELD_AE_ZONE, ae_zone);
+#undef CAMERA_SYNC
+
+	_valid |= fields & CAMERA_FIELD_ALL;
+
+	int count = __builtin_popcount(dirty);
+	Debug("camera param: %d of %d fields applied", count,
+	      __builtin_popcount(fields & CAMERA_FIELD_ALL));
+	return count;
+}
+
+/**
+ * @function	void ApplyFlash(const FlashParam *setting)
+ * @brief	下发闪光灯参数
+ *
+ */
+void SensorShadow::ApplyFlash(const FlashParam *setting)
+{
+	unsigned int mode = 0;
+	if (setting->flash_mode)
+		mode |= 0x01;
+	if (setting->led_mode)
+		mode |= 0x02;
+	if (setting->continuous_light)
+		mode |= 0x04;
+	Sensor::GetInstance()->SetSensorFlashMode(mode);
+
+	if (setting->redlight_sync_mode) {
+		Sensor::GetInstance()->SetSensorSyncOn();
+	} else {
+		Sensor::GetInstance()->SetSensorSyncOff();
+	}
+
+	Sensor::GetInstance()->SetSensorFlashDelay(setting->flash_delay);
+	Sensor::GetInstance()->SetSensorRedLightDelay(setting->redlight_delay);
+	Sensor::GetInstance()->SetSensorRedLightEfficient(setting->redlight_efficient);
+	Sensor::GetInstance()->SetSensorLEDMultiple(setting->led_mutiple);
+}
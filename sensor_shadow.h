@@ -0,0 +1,71 @@
+/**
+ * @file	sensor_shadow.h
+ * @brief	传感器参数影子类声明
+ * @author	agent <agent@local>
+ * @version	1.0.0
+ * @date	2026-10-16
+ *
+ * @verbatim
+ * ============================================================================
+ * Copyright (c) Shenzhen Landun technology Co.,Ltd. 2026
+ * All rights reserved. 
+ * 
+ * Use of this software is controlled by the terms and conditions found in the
+ * license agreenment under which this software has been supplied or provided.
+ * ============================================================================
+ * 
+ * @endverbatim
+ * 
+ */
+
+
+#ifndef _SENSORSHADOW_H_
+#define _SENSORSHADOW_H_
+
+#include <pthread.h>
+#include "ldczn_protocol.h"
+
+/* CameraParam字段掩码 */
+#define CAMERA_FIELD_AEW_MODE		(1 << 0)
+#define CAMERA_FIELD_DEFAULT_EXPOSURE	(1 << 1)
+#define CAMERA_FIELD_MIN_EXPOSURE	(1 << 2)
+#define CAMERA_FIELD_MAX_EXPOSURE	(1 << 3)
+#define CAMERA_FIELD_MIN_GAIN		(1 << 4)
+#define CAMERA_FIELD_MAX_GAIN		(1 << 5)
+#define CAMERA_FIELD_DEFAULT_GAIN	(1 << 6)
+#define CAMERA_FIELD_BLUE_GAIN		(1 << 7)
+#define CAMERA_FIELD_RED_GAIN		(1 << 8)
+#define CAMERA_FIELD_VIDEO_TARGET	(1 << 9)
+#define CAMERA_FIELD_CAPTURE_TARGET	(1 << 10)
+#define CAMERA_FIELD_AE_ZONE		(1 << 11)
+#define CAMERA_FIELD_ALL		0x0FFF
+
+/**
+ * 记录最后一次写入传感器的CameraParam，只下发有变化的字段，
+ * 避免每次参数设置都对传感器/FPGA做十余次寄存器操作。
+ * 多个reactor的传感器工作线程共用一个实例，访问传感器前后调用Lock/Unlock。
+ */
+class SensorShadow
+{
+
+public:
+	SensorShadow();
+	~SensorShadow();
+
+	void Lock()   { pthread_mutex_lock(&_lock); }
+	void Unlock() { pthread_mutex_unlock(&_lock); }
+
+	int  ApplyCamera(const CameraParam *setting, unsigned int fields);
+	void ApplyFlash(const FlashParam *setting);
+	void Invalidate();
+
+private:
+	CameraParam  _camera;	//已下发的相机参数
+	unsigned int _valid;	//_camera中与传感器一致的字段
+	pthread_mutex_t _lock;
+
+	bool Changed(unsigned int field, bool differ) const;
+	void ApplyAEMode(int aew_mode);
+};
+
+#endif
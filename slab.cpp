@@ -0,0 +1,137 @@
+/**
+ * @file	slab.cpp
+ * @brief	定长对象池类实现
+ * @author	agent <agent@local>
+ * @version 	1.0.0
+ * @date 	2026-10-16
+ *
+ * @verbatim
+ * ============================================================================
+ * Copyright (c) Shenzhen Landun technology Co.,Ltd. 2026
+ * All rights reserved. 
+ * 
+ * Use of this software is controlled by the terms and conditions found in the
+ * license agreenment under which this software has been supplied or provided.
+ * ============================================================================
+ * 
+ * @endverbatim
+ * 
+ */
+
+
+#include <stdlib.h>
+#include <string.h>
+#include "debug.h"
+#include "slab.h"
+
+
+//块头按8字节对齐，对象按8字节对齐
+#define SLAB_ALIGN(n)		(((n) + 7) & ~7U)
+#define SLAB_CHUNK_HEAD		SLAB_ALIGN(sizeof(struct Chunk))
+
+
+/* reserve: 预先申请的对象数，启动时申请好使运行中不再malloc */
+Slab::Slab(unsigned int size, unsigned int per_chunk, bool locked,
+	   unsigned int reserve)
+{
+	if (size < sizeof(void *))
+		size = sizeof(void *);
+	_size = SLAB_ALIGN(size);
+	_per_chunk = per_chunk > 0 ? per_chunk : 1;
+	_locked = locked;
+	pthread_mutex_init(&_lock, NULL);
+	_free = NULL;
+	_chunks = NULL;
+	memset(&_stat, 0, sizeof(_stat));
+	_stat.size = _size;
+	if (Reserve(reserve) < 0)
+		Debug("slab(%u) reserve %u failed", _size, reserve);
+}
+
+Slab::~Slab()
+{
+	if (_stat.in_use > 0)
+		Debug("slab(%u) released with %u objects in use", _size, _stat.in_use);
+
+	while (_chunks != NULL) {
+		struct Chunk *chunk = _chunks;
+		_chunks = chunk->next;
+		free(chunk);
+	}
+	pthread_mutex_destroy(&_lock);
+}
+
+/* 调用者持锁 */
+int Slab::Grow()
+{
+	struct Chunk *chunk = (struct Chunk *)malloc(SLAB_CHUNK_HEAD +
+						     _size * _per_chunk);
+	if (chunk == NULL)
+		return -1;
+
+	chunk->next = _chunks;
+	_chunks = chunk;
+
+	char *obj = (char *)chunk + SLAB_CHUNK_HEAD;
+	for (unsigned int i = 0; i < _per_chunk; i++, obj += _size) {
+		*(void **)obj = _free;
+		_free = obj;
+	}
+	_stat.total += _per_chunk;
+	return 0;
+}
+
+/**
+ * @function	int Reserve(unsigned int count)
+ * @brief	预先申请至少count个对象
+ * @return	0成功，-1内存不足
+ */
+int Slab::Reserve(unsigned int count)
+{
+	int ret = 0;
+	Lock();
+	while (_stat.total < count) {
+		if (Grow() < 0) {
+			ret = -1;
+			break;
+		}
+	}
+	Unlock();
+	return ret;
+}
+
+void *Slab::Alloc()
+{
+	Lock();
+	if (_free == NULL && Grow() < 0) {
+		_stat.fails++;
+		Unlock();
+		return NULL;
+	}
+
+	void *obj = _free;
+	_free = *(void **)obj;
+	if (++_stat.in_use > _stat.peak)
+		_stat.peak = _stat.in_use;
+	Unlock();
+	return obj;
+}
+
+void Slab::Free(void *obj)
+{
+	if (obj == NULL)
+		return;
+
+	Lock();
+	*(void **)obj = _free;
+	_free = obj;
+	_stat.in_use--;
+	Unlock();
+}
+
+void Slab::GetStat(struct SlabStat *stat)
+{
+	Lock();
+	*stat = _stat;
+	Unlock();
+}
@@ -0,0 +1,71 @@
+/**
+ * @file	slab.h
+ * @brief	定长对象池类声明
+ * @author	agent <agent@local>
+ * @version	1.0.0
+ * @date	2026-10-16
+ *
+ * @verbatim
+ * ============================================================================
+ * Copyright (c) Shenzhen Landun technology Co.,Ltd. 2026
+ * All rights reserved. 
+ * 
+ * Use of this software is controlled by the terms and conditions found in the
+ * license agreenment under which this software has been supplied or provided.
+ * ============================================================================
+ * 
+ * @endverbatim
+ * 
+ */
+
+
+#ifndef _SLAB_H_
+#define _SLAB_H_
+
+#include <pthread.h>
+
+struct SlabStat {
+	unsigned int size;	//对象大小
+	unsigned int total;	//已向系统申请的对象数(含空闲)
+	unsigned int in_use;	//使用中的对象数
+	unsigned int peak;	//使用中的最大值
+	unsigned int fails;	//分配失败次数
+};
+
+/**
+ * 定长对象池: 每次向系统申请per_chunk个对象，释放的对象挂回空闲链表，
+ * 达到峰值后不再malloc。申请的内存在对象池析构时才归还。
+ * locked为false时仅供一个线程使用(如各reactor的连接池)，不加锁。
+ */
+class Slab
+{
+
+public:
+	Slab(unsigned int size, unsigned int per_chunk, bool locked,
+	     unsigned int reserve = 0);
+	~Slab();
+
+	int  Reserve(unsigned int count);
+	void *Alloc();
+	void Free(void *obj);
+	void GetStat(struct SlabStat *stat);
+
+private:
+	struct Chunk {
+		struct Chunk *next;
+	};
+
+	unsigned int _size;		//按8字节对齐后的对象大小
+	unsigned int _per_chunk;
+	bool _locked;
+	pthread_mutex_t _lock;
+	void *_free;			//空闲对象链表，链接字放在对象头部
+	struct Chunk *_chunks;
+	struct SlabStat _stat;
+
+	int  Grow();
+	void Lock() { if (_locked) pthread_mutex_lock(&_lock); }
+	void Unlock() { if (_locked) pthread_mutex_unlock(&_lock); }
+};
+
+#endif
@@ -0,0 +1,317 @@
+/**
+ * @file	tcp_connection.cpp
+ * @brief	TCP客户端连接类实现
+ * @author	agent <agent@local>
+ * @version 	1.0.0
+ * @date 	2026-10-16
+ *
+ * @verbatim
+ * ============================================================================
+ * Copyright (c) Shenzhen Landun technology Co.,Ltd. 2026
+ * All rights reserved. 
+ * 
+ * Use of this software is controlled by the terms and conditions found in the
+ * license agreenment under which this software has been supplied or provided.
+ * ============================================================================
+ * 
+ * @endverbatim
+ * 
+ */
+
+
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include "socket.h"
+#include "tx_buffer.h"
+#include "timer_wheel.h"
+#include "upgrade_receiver.h"
+#include "tcp_connection.h"
+
+
+TcpConnection::TcpConnection(int sock)
+{
+	_sock = sock;
+	_rd = 0;
+	_wr = 0;
+	_tx_head = 0;
+	_tx_count = 0;
+	_tx_bytes = 0;
+	_tx_sent = 0;
+	_arena_used = 0;
+	upgrade = NULL;
+	notify_mask = 0;
+	id = 0;
+	priority = false;
+	timer_init(&idle_timer, CONN_TIMER_IDLE, this);
+	timer_init(&write_timer, CONN_TIMER_WRITE, this);
+	memset(&exchange, 0, sizeof(exchange));
+	timer_init(&exchange.timer, CONN_TIMER_EXCHANGE, this);
+	last_rx = 0;
+	tx_mark = 0;
+	heartbeat = false;
+	snap_scan = 0;
+	snap_fired = false;
+	prev = NULL;
+	next = NULL;
+}
+
+
+TcpConnection::~TcpConnection()
+{
+	Close();
+	delete upgrade;
+	while (_tx_count > 0) {
+		PopSegment();
+	}
+}
+
+
+void TcpConnection::Close()
+{
+	if (_sock >= 0) {
+		Socket::Close(_sock);
+		_sock = -1;
+	}
+}
+
+
+bool TcpConnection::Streaming() const
+{
+	return upgrade != NULL && upgrade->Streaming();
+}
+
+
+void TcpConnection::Compact()
+{
+	if (_rd == 0)
+		return;
+
+	if (_wr > _rd)
+		memmove(_rbuf, _rbuf + _rd, _wr - _rd);
+	_wr -= _rd;
+	_rd = 0;
+}
+
+/**
+ * @function	void Align()
+ * @brief	帧起始地址未按4字节对齐时移回缓冲头部，避免非对齐访问
+ *
+ */
+void TcpConnection::Align()
+{
+	if (_rd & 0x03)
+		Compact();
+}
+
+void TcpConnection::Consume(unsigned int len)
+{
+	if (len > DataLen())
+		len = DataLen();
+
+	snap_scan = snap_scan > len ? snap_scan - len : 0;
+	_rd += len;
+	if (_rd == _wr) {
+		_rd = 0;
+		_wr = 0;
+	}
+}
+
+/**
+ * @function	int Fill()
+ * @brief	边沿触发下读取socket直到EAGAIN或缓冲已满
+ * @return	CONN_FILL_AGAIN/CONN_FILL_FULL/CONN_FILL_CLOSED
+ */
+int TcpConnection::Fill()
+{
+	unsigned int start;
+	int status = CONN_FILL_FULL;
+
+	if (_wr == sizeof(_rbuf))
+		Compact();
+
+	start = _wr;
+	while (_wr < sizeof(_rbuf)) {
+		int ret = read(_sock, _rbuf + _wr, sizeof(_rbuf) - _wr);
+		if (ret > 0) {
+			_wr += ret;
+			continue;
+		}
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			status = CONN_FILL_AGAIN;
+		else
+			status = CONN_FILL_CLOSED;
+		break;
+	}
+
+	//只有真正读到数据才刷新，空闲定时器到期时按last_rx重新计算
+	if (_wr != start)
+		last_rx = TimerWheel::Ticks();
+
+	return status;
+}
+
+/**
+ * @function	int Read(char *buf, int len, int timeout)
+ * @brief	先取走缓冲中已收到的数据，缓冲为空时再读socket
+ *
+ */
+int TcpConnection::Read(char *buf, int len, int timeout)
+{
+	unsigned int avail = DataLen();
+	if (avail > 0) {
+		if ((unsigned int)len > avail)
+			len = avail;
+		memcpy(buf, Data(), len);
+		Consume(len);
+		return len;
+	}
+
+	return Socket::Read(_sock, buf, len, timeout);
+}
+
+void TcpConnection::PopSegment()
+{
+	struct TxSegment *seg = &_txq[_tx_head];
+	_tx_bytes -= seg->len;
+	tx_buffer_put(seg->buf);
+	seg->buf = NULL;
+	_tx_head = (_tx_head + 1) % CONN_TX_QUEUE_DEPTH;
+	_tx_count--;
+}
+
+/**
+ * @function	int Enqueue(struct TxBuffer *buf, unsigned int off, unsigned int len)
+ * @brief	将共享发送缓冲的一段加入输出队列，成功时持有一个引用
+ * @return	0成功，-1队列已满
+ */
+int TcpConnection::Enqueue(struct TxBuffer *buf, unsigned int off, unsigned int len)
+{
+	if (_tx_count >= CONN_TX_QUEUE_DEPTH)
+		return -1;
+
+	struct TxSegment *seg = &_txq[(_tx_head + _tx_count) % CONN_TX_QUEUE_DEPTH];
+	tx_buffer_get(buf);
+	seg->buf = buf;
+	seg->off = off;
+	seg->len = len;
+	_tx_count++;
+	_tx_bytes += len;
+	return 0;
+}
+
+/**
+ * @function	int Send(const char *buf, int len)
+ * @brief	拷贝应答包到输出队列，小包追加到队尾私有缓冲中合并
+ * @return	0成功，-1队列已满或内存不足
+ */
+int TcpConnection::Send(const char *buf, int len)
+{
+	if (_tx_count > 0) {
+		struct TxSegment *tail = &_txq[(_tx_head + _tx_count - 1) %
+					CONN_TX_QUEUE_DEPTH];
+		struct TxBuffer *tb = tail->buf;
+		if (tb->refs == 1 && tail->off + tail->len == tb->len &&
+		    tb->size - tb->len >= (unsigned int)len) {
+			memcpy(tb->data + tb->len, buf, len);
+			tb->len += len;
+			tail->len += len;
+			_tx_bytes += len;
+			return 0;
+		}
+	}
+
+	struct TxBuffer *tb = tx_buffer_alloc(len);
+	if (tb == NULL)
+		return -1;
+
+	memcpy(tb->data, buf, len);
+	tb->len = len;
+	int ret = Enqueue(tb, 0, len);
+	tx_buffer_put(tb);
+	return ret;
+}
+
+/**
+ * @function	int Flush()
+ * @brief	用一次sendmsg发出输出队列中的全部分段，未发完的部分等待EPOLLOUT
+ * @return	0成功或暂不可写，-1连接出错
+ */
+int TcpConnection::Flush()
+{
+	while (_tx_count > 0) {
+		ssize_t ret = sendmsg(_sock, TxMsg(), MSG_NOSIGNAL | MSG_DONTWAIT);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+				return 0;
+			return -1;
+		}
+
+		Sent(ret);
+	}
+
+	return 0;
+}
+
+/**
+ * @function	struct msghdr *TxMsg()
+ * @brief	用输出队列的全部分段生成sendmsg参数，Sent()之前队列不能改变
+ *
+ */
+struct msghdr *TcpConnection::TxMsg()
+{
+	for (unsigned int i = 0; i < _tx_count; i++) {
+		struct TxSegment *seg = &_txq[(_tx_head + i) % CONN_TX_QUEUE_DEPTH];
+		_tx_iov[i].iov_base = seg->buf->data + seg->off;
+		_tx_iov[i].iov_len  = seg->len;
+	}
+
+	memset(&_tx_msg, 0, sizeof(_tx_msg));
+	_tx_msg.msg_iov    = _tx_iov;
+	_tx_msg.msg_iovlen = _tx_count;
+	return &_tx_msg;
+}
+
+/**
+ * @function	void Sent(unsigned int len)
+ * @brief	从队列头部移除已发送的len字节
+ *
+ */
+void TcpConnection::Sent(unsigned int len)
+{
+	_tx_sent += len;
+	while (len > 0) {
+		struct TxSegment *seg = &_txq[_tx_head];
+		if (len < seg->len) {
+			seg->off += len;
+			seg->len -= len;
+			_tx_bytes -= len;
+			break;
+		}
+		len -= seg->len;
+		PopSegment();
+	}
+}
+
+/**
+ * @function	void *Scratch(unsigned int len)
+ * @brief	从连接的临时内存中分配len字节(8字节对齐)，不需释放，
+ *		每帧处理完后复位，不能保存跨帧的数据
+ * @return	NULL表示临时内存已用完
+ */
+void *TcpConnection::Scratch(unsigned int len)
+{
+	len = (len + 7) & ~7U;
+	if (len > sizeof(_arena) - _arena_used)
+		return NULL;
+
+	void *p = _arena + _arena_used;
+	_arena_used += len;
+	return p;
+}
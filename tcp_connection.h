@@ -0,0 +1,132 @@
+/**
+ * @file	tcp_connection.h
+ * @brief	TCP客户端连接类声明
+ * @author	agent <agent@local>
+ * @version	1.0.0
+ * @date	2026-10-16
+ *
+ * @verbatim
+ * ============================================================================
+ * Copyright (c) Shenzhen Landun technology Co.,Ltd. 2026
+ * All rights reserved. 
+ * 
+ * Use of this software is controlled by the terms and conditions found in the
+ * license agreenment under which this software has been supplied or provided.
+ * ============================================================================
+ * 
+ * @endverbatim
+ * 
+ */
+
+
+#ifndef _TCPCONNECTION_H_
+#define _TCPCONNECTION_H_
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include "timer_wheel.h"
+#include "exchange.h"
+
+#define CONN_RECV_BUF_SIZE	(16 * 1024)
+#define CONN_TX_QUEUE_DEPTH	64		//输出队列最大分段数
+#define CONN_TX_HIGH_WATER	(32 * 1024)	//超过后暂停解析该连接的请求
+#define CONN_TX_LOW_WATER	(8 * 1024)	//回落后恢复解析
+#define CONN_ARENA_SIZE		(4 * 1024)	//请求处理的临时内存
+
+//Fill()返回值
+#define CONN_FILL_AGAIN		0	//socket已读空(EAGAIN)
+#define CONN_FILL_FULL		1	//接收缓冲已满，需先解析
+#define CONN_FILL_CLOSED	-1	//对端关闭或出错
+
+//连接定时器类型
+#define CONN_TIMER_IDLE		0	//读空闲/心跳超时
+#define CONN_TIMER_WRITE	1	//输出队列停滞超时
+#define CONN_TIMER_EXCHANGE	2	//多步交互的等待期限
+
+struct TxBuffer;
+class UpgradeReceiver;
+
+class TcpConnection
+{
+
+public:
+	TcpConnection(int sock);
+	~TcpConnection();
+
+	int  Fd() const { return _sock; }
+	void Close();
+
+	int  Fill();
+	int  Read(char *buf, int len, int timeout);
+
+	char *Data() { return _rbuf + _rd; }
+	unsigned int DataLen() const { return _wr - _rd; }
+	unsigned int Capacity() const { return sizeof(_rbuf); }
+	void Consume(unsigned int len);
+	void Align();
+
+	int  Send(const char *buf, int len);
+	int  Enqueue(struct TxBuffer *buf, unsigned int off, unsigned int len);
+	int  Flush();
+	struct msghdr *TxMsg();
+	void Sent(unsigned int len);
+	bool TxPending() const { return _tx_count > 0; }
+	bool TxBlocked() const { return _tx_bytes >= CONN_TX_HIGH_WATER ||
+				_tx_count >= CONN_TX_QUEUE_DEPTH - 4; }
+	bool TxDrained() const { return _tx_bytes <= CONN_TX_LOW_WATER; }
+	unsigned int TxSent() const { return _tx_sent; }
+
+	void *Scratch(unsigned int len);
+	void ResetScratch() { _arena_used = 0; }
+
+	UpgradeReceiver *upgrade;	//升级接收状态
+	unsigned int notify_mask;	//订阅的通知事件
+	unsigned int id;		//连接编号，异步应答按编号查找连接
+	bool priority;			//收到控制请求，下一轮优先处理，处理后清除
+	bool Streaming() const;		//后续数据为整包升级文件流
+	struct Exchange exchange;	//进行中的多步交互
+	bool InExchange() const { return exchange.type != EXCHANGE_NONE; }
+
+	struct Timer idle_timer;	//读空闲/心跳超时
+	struct Timer write_timer;	//输出队列停滞超时
+	unsigned long long last_rx;	//最后收到数据的tick
+	unsigned int tx_mark;		//写超时开始计时时的已发送字节数
+	bool heartbeat;			//客户端发送心跳，按心跳超时判断存活
+	unsigned int snap_scan;		//FireSnaps已扫描的字节数(从Data()起)，其中的抓拍已触发
+	bool snap_fired;		//正在处理的帧在已扫描范围内，抓拍已提前触发
+
+	TcpConnection *prev;	//reactor连接链表
+	TcpConnection *next;
+
+private:
+	int  _sock;		//客户端socket
+
+	//接收环形缓冲: [_rd, _wr)为未解析数据，帧在缓冲内原地解析；
+	//写到尾部时将残留的半帧移回头部，保证每帧在内存中连续
+	unsigned int _rd;
+	unsigned int _wr;
+	char _rbuf[CONN_RECV_BUF_SIZE] __attribute__((aligned(8)));
+
+	//输出队列: 按请求顺序排列的分段，每次可写事件用一次sendmsg批量发出
+	struct TxSegment {
+		struct TxBuffer *buf;
+		unsigned int off;
+		unsigned int len;
+	};
+	struct TxSegment _txq[CONN_TX_QUEUE_DEPTH];
+	unsigned int _tx_head;
+	unsigned int _tx_count;
+	unsigned int _tx_bytes;
+	unsigned int _tx_sent;	//累计发送字节数
+	struct msghdr _tx_msg;	//TxMsg()生成，io_uring发送完成前保持有效
+	struct iovec _tx_iov[CONN_TX_QUEUE_DEPTH];
+
+	//请求临时内存: 处理一帧请求时顺序分配，该帧处理完后整体复位
+	char _arena[CONN_ARENA_SIZE] __attribute__((aligned(8)));
+	unsigned int _arena_used;
+
+	void Compact();
+	void PopSegment();
+};
+
+#endif
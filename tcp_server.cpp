@@ -19,51 +19,262 @@
  */
 
 
+#include <new>
 #include <unistd.h>
 #include <string.h>
 #include <signal.h>
+#include <errno.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <pthread.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <time.h>
 #include "socket.h"
 #include "tcp_client.h"
+#include "tcp_connection.h"
 #include "tcp_server.h"
+#include "upgrade_receiver.h"
+#include "tx_buffer.h"
+#include "ldczn_protocol_ext.h"
+#include "packet_codec.h"
 #include "sensor.h"
 #include "gpio.h"
 #include "debug.h"
 #include "parameters.h"
+#include "param_store.h"
 #include "uart.h"
 #include "util.h" 
 #include "peripherral_manage.h"
 
 
 #define RECV_BUF_LENGTH 1024
-
-static inline void fill_std_header(struct header_std *head,
-                                   char encoding,
-                                   char *auth_code,
-                                   char msg_type,
-                                   unsigned int msg_size)
+#define MAX_EPOLL_EVENTS 64
+
+#ifndef SO_BUSY_POLL
+#define SO_BUSY_POLL	46
+#endif
+#ifndef SO_REUSEPORT
+#define SO_REUSEPORT	15
+#endif
+
+#define SERVER_BACKLOG	128	//监控客户端集中连接时，触发类连接不被挤出队列
+
+#define CONN_IDLE_TIMEOUT_MS		(5 * 60 * 1000)	//未发心跳的连接无数据即断开
+#define CONN_HEARTBEAT_TIMEOUT_MS	(30 * 1000)	//发过心跳的连接，约3个心跳周期
+#define CONN_WRITE_TIMEOUT_MS		(10 * 1000)	//输出队列无进展即断开
+#define UPGRADE_STALL_MS		(15 * 1000)	//升级文件流中断即断开
+#define TIME_CALIBRATE_MS		(5 * 1000)	//校时未完成即回复失败
+
+#define RING_ENTRIES	256
+#define CONN_SLAB_CHUNK	8	//连接对象池每次申请的个数
+#define RING_ACCEPT	1ULL	//accept完成事件的user_data，发送为连接指针
+
+//有其他连接等待时，每轮epoll事件各类请求的处理上限，超出回ACK_EXT_BUSY
+static const unsigned int class_budget[REQ_CLASS_NUM] = {
+	0xFFFFFFFF,	//REQ_CLASS_CONTROL
+	32,		//REQ_CLASS_SET
+	64,		//REQ_CLASS_GET
+	64,		//REQ_CLASS_HEARTBEAT
+};
+
+//param_all_types按参数组编号排列，参数组增减时同时修改(数组长度为负即编译报错)
+typedef char param_all_types_match[PARAM_ALL_TYPES == PARAM_GROUP_NUM ? 1 : -1];
+
+//各分片线程共用的上传客户端和抓拍GPIO，调用串行化
+static pthread_mutex_t client_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t snap_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void fire_snap()
 {
-        const char magic[] = PROTOCOL_MAGIC;
-        memcpy(head->magic, magic, sizeof(magic));
-        head->protocol_major = PROTOCOL_MAJOR;
-        head->protocol_minor = PROTOCOL_MINOR;
-        head->encoding       = encoding;
-        memcpy(head->auth_code, auth_code, sizeof(head->auth_code));
-        head->msg_type       = msg_type;
-        head->msg_size       = msg_size;
+	pthread_mutex_lock(&snap_lock);
+	GpioCtl::MannualSnap();
+	pthread_mutex_unlock(&snap_lock);
 }
 
+#define UPG_APP(op)	(REQ_TYPE_MANUFACTURE | REQ_MAN_UPG),			\
+			(REQ_MAN_UPG_OP_MASK | 0x000000FF), ((op) | REQ_MAN_UPG_APP)
+
+/*
+ * 请求分发表: 主类型|子类型、cmd_mask、cmd、定长负载、类别、参数组、标志、处理函数。
+ * 新的请求类型在此增加一项，或在Start之前调用RegisterRequest。
+ * 升级请求后可能跟随文件流，不能丢弃，按REQ_CLASS_CONTROL准入。
+ */
+const struct RequestHandler TcpServer::_request_handlers[] = {
+	{ REQ_TYPE_HEARTBEAT, 0, 0, 0,
+	  REQ_CLASS_HEARTBEAT, -1, REQ_FLAG_ANY_SUB,
+	  &TcpServer::ProcessHeartBeat, "heartbeat" },
+
+	{ UPG_APP(UPG_OP_STREAM), sizeof(struct payload_man_upgrade),
+	  REQ_CLASS_CONTROL, -1, 0,
+	  &TcpServer::ProcessUpgradeApp, "upgrade stream" },
+	{ UPG_APP(UPG_OP_RESUME), sizeof(struct payload_man_upgrade),
+	  REQ_CLASS_CONTROL, -1, 0,
+	  &TcpServer::ProcessUpgradeResume, "upgrade resume" },
+	{ UPG_APP(UPG_OP_CHUNK), sizeof(struct payload_upgrade_chunk),
+	  REQ_CLASS_CONTROL, -1, 0,
+	  &TcpServer::ProcessUpgradeChunk, "upgrade chunk" },
+	{ UPG_APP(UPG_OP_COMMIT), sizeof(struct payload_upgrade_commit),
+	  REQ_CLASS_CONTROL, -1, 0,
+	  &TcpServer::ProcessUpgradeCommit, "upgrade commit" },
+
+	{ REQ_TYPE_CONTROL | CTL_TYPE_VIDEO, 0, 0, 0,
+	  REQ_CLASS_CONTROL, -1, 0,
+	  &TcpServer::ProcessControl, "video mode" },
+	{ REQ_TYPE_CONTROL | CTL_TYPE_CAPTURE, 0, 0, 0,
+	  REQ_CLASS_CONTROL, -1, 0,
+	  &TcpServer::ProcessControl, "capture mode" },
+	{ REQ_TYPE_CONTROL | CTL_TYPE_MANNUAL_SNAP, 0, 0, 0,
+	  REQ_CLASS_CONTROL, -1, 0,
+	  &TcpServer::ProcessControl, "manual snap" },
+	{ REQ_TYPE_CONTROL | CTL_TYPE_REBOOT, 0, 0, 0,
+	  REQ_CLASS_CONTROL, -1, 0,
+	  &TcpServer::ProcessControl, "reboot" },
+	{ REQ_TYPE_CONTROL, 0, 0, 0,
+	  REQ_CLASS_CONTROL, -1, REQ_FLAG_ANY_SUB | REQ_FLAG_ACK,
+	  NULL, "control" },
+
+	{ REQ_TYPE_SET_PARAMETER | PARAM_TYPE_CAMERA, 0, 0, sizeof(CameraParam),
+	  REQ_CLASS_SET, PARAM_GROUP_CAMERA, REQ_FLAG_ACK,
+	  &TcpServer::ProcessSetCameraParameter, "set camera" },
+	{ REQ_TYPE_SET_PARAMETER | PARAM_TYPE_NETWORK, 0, 0, sizeof(NetworkParam),
+	  REQ_CLASS_SET, PARAM_GROUP_NETWORK, REQ_FLAG_ACK,
+	  &TcpServer::ProcessSetNetworkParam, "set network" },
+	{ REQ_TYPE_SET_PARAMETER | PARAM_TYPE_UPLOAD, 0, 0, sizeof(UploadParam),
+	  REQ_CLASS_SET, PARAM_GROUP_UPLOAD, REQ_FLAG_ACK,
+	  &TcpServer::ProcessSetUploadParam, "set upload" },
+	{ REQ_TYPE_SET_PARAMETER | PARAM_TYPE_TIME, 0, 0, sizeof(Ldczn_time),
+	  REQ_CLASS_SET, -1, 0,
+	  &TcpServer::ProcessCalibrateTime, "calibrate time" },
+	{ REQ_TYPE_SET_PARAMETER | PARAM_TYPE_FLASH, 0, 0, sizeof(FlashParam),
+	  REQ_CLASS_SET, PARAM_GROUP_FLASH, REQ_FLAG_ACK,
+	  &TcpServer::ProcessSetFlashParam, "set flash" },
+	{ REQ_TYPE_SET_PARAMETER | PARAM_TYPE_DEVICE_INFO, 0, 0, sizeof(DeviceInfo),
+	  REQ_CLASS_SET, PARAM_GROUP_DEVICE_INFO, REQ_FLAG_ACK,
+	  &TcpServer::ProcessSetDeviceInfo, "set device info" },
+	//参数事务单独应答
+	{ REQ_TYPE_SET_PARAMETER | PARAM_TYPE_ALL, 0, 0, 0,
+	  REQ_CLASS_SET, -1, 0,
+	  &TcpServer::ProcessSetAllParam, "set all" },
+	//车牌、视频检测等未实现的参数只应答
+	{ REQ_TYPE_SET_PARAMETER, 0, 0, 0,
+	  REQ_CLASS_SET, -1, REQ_FLAG_ANY_SUB | REQ_FLAG_ACK,
+	  NULL, "set other" },
+
+	{ REQ_TYPE_GET_PARAMETER | PARAM_TYPE_CAMERA, 0, 0, 0,
+	  REQ_CLASS_GET, PARAM_GROUP_CAMERA, REQ_FLAG_CACHED,
+	  NULL, "get camera" },
+	{ REQ_TYPE_GET_PARAMETER | PARAM_TYPE_NETWORK, 0, 0, 0,
+	  REQ_CLASS_GET, PARAM_GROUP_NETWORK, REQ_FLAG_CACHED,
+	  NULL, "get network" },
+	{ REQ_TYPE_GET_PARAMETER | PARAM_TYPE_UPLOAD, 0, 0, 0,
+	  REQ_CLASS_GET, PARAM_GROUP_UPLOAD, REQ_FLAG_CACHED,
+	  NULL, "get upload" },
+	{ REQ_TYPE_GET_PARAMETER | PARAM_TYPE_FLASH, 0, 0, 0,
+	  REQ_CLASS_GET, PARAM_GROUP_FLASH, REQ_FLAG_CACHED,
+	  NULL, "get flash" },
+	{ REQ_TYPE_GET_PARAMETER | PARAM_TYPE_DEVICE_INFO, 0, 0, 0,
+	  REQ_CLASS_GET, PARAM_GROUP_DEVICE_INFO, REQ_FLAG_CACHED,
+	  NULL, "get device info" },
+	{ REQ_TYPE_GET_PARAMETER | PARAM_TYPE_TRAFFIC, 0, 0, 0,
+	  REQ_CLASS_GET, PARAM_GROUP_TRAFFIC, REQ_FLAG_CACHED,
+	  NULL, "get traffic" },
+	{ REQ_TYPE_GET_PARAMETER | PARAM_TYPE_ALL, 0, 0, 0,
+	  REQ_CLASS_GET, -1, 0,
+	  &TcpServer::ProcessGetAllParam, "get all" },
+	{ REQ_TYPE_GET_PARAMETER | PARAM_TYPE_METRICS, 0, 0, 0,
+	  REQ_CLASS_GET, -1, 0,
+	  &TcpServer::ProcessGetMetrics, "get metrics" },
+
+	{ REQ_TYPE_SUBSCRIBE, 0, 0, sizeof(struct payload_subscribe),
+	  REQ_CLASS_GET, -1, REQ_FLAG_ANY_SUB,
+	  &TcpServer::ProcessSubscribe, "subscribe" },
+
+	{ 0, 0, 0, 0, 0, -1, 0, NULL, NULL },
+};
+
 TcpServer::TcpServer(TcpClient *client)
+	: _coalescer(&_sensor_shadow, &_workers),
+	  _conn_slab(sizeof(TcpConnection), CONN_SLAB_CHUNK, false)
 {
-	server_sock = -1;
-	clnt_sock = -1;
+	InitState();
+	_shadow = &_sensor_shadow;
+	_sensor_host = this;
+	_shard_count = 1;
+	_shards[0] = this;
 
 	_tcp_client = client;
+	_requests.RegisterAll(_request_handlers);
+	ParamStore::GetInstance()->Load();
 	InitClient();
 }
 
+/* 分片reactor: 设置与主reactor相同，参数下发和模式切换经主reactor执行 */
+TcpServer::TcpServer(TcpServer *primary, int shard)
+	: _coalescer(&_sensor_shadow, &_workers),
+	  _conn_slab(sizeof(TcpConnection), CONN_SLAB_CHUNK, false)
+{
+	InitState();
+	_shadow = primary->_shadow;
+	_sensor_host = primary;
+	_primary = primary;
+	_shard = shard;
+	_rt_priority = primary->_rt_priority;
+	_rt_cpu = -1;
+	if (primary->_rt_cpu >= 0) {
+		//分片依次绑定后续CPU，超出在线CPU数时从0回绕
+		long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		_rt_cpu = primary->_rt_cpu + shard;
+		if (cpus > 0)
+			_rt_cpu %= cpus;
+	}
+	_busy_poll_us = primary->_busy_poll_us;
+	_ring_enabled = primary->_ring_enabled;
+	_requests = primary->_requests;	//含运行前注册的处理项
+	_tcp_client = primary->_tcp_client;
+}
+
+void TcpServer::InitState()
+{
+	server_sock = -1;
+	clnt_sock = -1;
+	_epoll_fd = -1;
+	_wakeup_fd = -1;
+	_idle_fd = -1;
+	_conns = NULL;
+	_closed = NULL;
+	_next_conn_id = 0;
+	_current = NULL;
+	_payload_end = NULL;
+	_notify_pending = false;
+	_round_waiting = 0;
+	memset(_admitted, 0, sizeof(_admitted));
+	_rt_priority = 0;
+	_rt_cpu = -1;
+	_busy_poll_us = 0;
+	_udp_enabled = false;
+	_shadow = NULL;
+	_sensor_host = NULL;
+	_primary = NULL;
+	_shard = 0;
+	_shard_count = 0;
+	memset(_shards, 0, sizeof(_shards));
+	_joinable = false;
+	_ring_enabled = false;
+	_ring_accept = false;
+	_ring_sends = 0;
+	_tcp_client = NULL;
+}
+
 
 TcpServer::~TcpServer()
 {
+	Release();
 	server_sock = -1;
 	clnt_sock = -1;
 
@@ -74,415 +285,1573 @@ TcpServer::~TcpServer()
 
 void TcpServer::InitClient()
 {
-	UploadParam param = Parameters::GetInstance()->GetUploadParam();
+	UploadParam param = ParamStore::GetInstance()->GetUploadParam();
 	struct _ClientInfo client_info; 
 	memcpy(client_info.addr, param.upload_server, sizeof(client_info.addr));
+	pthread_mutex_lock(&client_lock);
 	_tcp_client->SetClient(&client_info);
+	pthread_mutex_unlock(&client_lock);
 }
 
 /**
- * @function	void Init()
- * @brief	初始化tcp server，并监听39002端口
- *
+ * @function	int Init()
+ * @brief	初始化tcp server，监听39002端口并创建epoll/eventfd
+ * @return	0成功，-1失败
  */
-void TcpServer::Init()
+int TcpServer::Init()
 {
 	server_sock = Socket::CreateTcp();
 	if (server_sock < 0) {
 		Debug("Create Nonblock Tcp failed");
-		return;
+		return -1;
 	}
 
 	Socket::SetNonblock(server_sock);
+	if (_shard_count > 1 || _primary != NULL) {
+		//各分片绑定同一端口，由内核按连接分配
+		int on = 1;
+		if (setsockopt(server_sock, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) < 0) {
+			Debug("set SO_REUSEPORT failed");
+			Release();
+			return -1;
+		}
+	}
 	int ret = Socket::Bind(server_sock, 39002);
 	if (ret < 0) {
 		Debug("Bind port 39002 failed");
-		Socket::Close(server_sock);
-		return;
+		Release();
+		return -1;
 	}
 
-	ret = Socket::Listen(server_sock, 5);
+	ret = Socket::Listen(server_sock, SERVER_BACKLOG);
 	if (ret < 0) {
 		Debug("Listen port failed");
-		Socket::Close(server_sock);
-		return;
+		Release();
+		return -1;
 	}
-}
 
-void TcpServer::Run()
-{
-	Init();
+	_epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	_wakeup_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	_idle_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+	if (_epoll_fd < 0 || _wakeup_fd < 0) {
+		Debug("Create epoll failed");
+		Release();
+		return -1;
+	}
 
-	char buf[RECV_BUF_LENGTH];
-	while (!IsTerminated()) {
-		clnt_sock = Socket::Accept(server_sock, 10000);
-		if (clnt_sock < 0) {
-			usleep(100000);	
-			continue;
-		}
+	struct epoll_event ev;
+	if (_ring_enabled && _ring.Init(RING_ENTRIES) == 0) {
+		ev.events = EPOLLIN;
+		ev.data.ptr = &_ring;
+		if (epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, _ring.Fd(), &ev) < 0)
+			_ring.Release();
+	}
 
-		int ret = Socket::Read(clnt_sock, buf, RECV_BUF_LENGTH, 5000); 
-		if (ret <= 0) {
-			Debug("remote is not alive");
-		} else if ((unsigned int)ret < sizeof(PacketRequest)) {
-			Debug("got %d packet, buf too less packet", ret);
-		} else {
-			ParsePacket(buf, ret);
+	//io_uring不可用时监听socket加入epoll
+	if (!ArmAccept()) {
+		ev.events = EPOLLIN | EPOLLET;
+		ev.data.ptr = &server_sock;
+		if (epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, server_sock, &ev) < 0) {
+			Debug("Add listen socket to epoll failed");
+			Release();
+			return -1;
 		}
-		Socket::Close(clnt_sock);
-		clnt_sock = -1;
-		usleep(100000);	
-	}
-	
-	if (clnt_sock >= 0) {
-		Socket::Close(clnt_sock);
 	}
-	Socket::Close(server_sock);
-}
-
-
-static inline int get_auth_code(char *auth_code, int len)
-{
-	auth_code = auth_code;
-	len = len;
-	return 0;
-}
 
-static inline int match_auth_code(const char *auth_code, int len)
-{
-	auth_code = auth_code;
-	len = len;
-	return 0;
-}
-
-
-int TcpServer::SendToClient(char *buf, int len)
-{
-	Debug();
-	return Socket::Writen(clnt_sock, buf, len, 2000);
-}
-
-
-int TcpServer::ParsePacket(char *buf, int len)
-{
-	if ((unsigned int)len < sizeof(struct header_std)) {
-		return -1;
-	}
-	
-	struct header_std *head = (struct header_std *)buf;
-	if (ProcessHeader(head, len)) {
+	ev.events = EPOLLIN;
+	ev.data.ptr = &_wakeup_fd;
+	if (epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, _wakeup_fd, &ev) < 0) {
+		Debug("Add eventfd to epoll failed");
+		Release();
 		return -1;
 	}
 
-	switch (head->msg_type) {
-	case MESSAGE_TYPE_REQ:
-		ProcessRequest((struct payload_req *)(buf + sizeof(*head)),
-				buf + sizeof(*head) + sizeof(struct payload_req));
-		break;
-	case MESSAGE_TYPE_ACK:
-		ProcessAck((struct payload_ack *)(buf + sizeof(*head)),
-				buf + sizeof(*head) + sizeof(struct payload_ack));
-		break;
-	default:
-		break;
+	if (_timers.Init() < 0) {
+		Release();
+		return -1;
 	}
-
-	return len - head->msg_size;
-}
-
-int TcpServer::ProcessHeader(struct header_std *head, int packet_len)
-{
-	const char magic[sizeof(head->magic)] = PROTOCOL_MAGIC;
-	Debug();
-
-	if (memcmp(head->magic, magic, sizeof(magic)) != 0) {
+	ev.events = EPOLLIN;
+	ev.data.ptr = &_timers;
+	if (epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, _timers.Fd(), &ev) < 0) {
+		Debug("Add timerfd to epoll failed");
+		Release();
 		return -1;
 	}
 
-	if ((head->protocol_major != PROTOCOL_MAJOR) ||
-		(head->protocol_minor != PROTOCOL_MINOR)) {
+	if (_workers.Init() < 0) {
+		Release();
 		return -1;
 	}
-
-	if (head->encoding != ENCODING_TYPE_RAW) {
+	ev.events = EPOLLIN;
+	ev.data.ptr = &_workers;
+	if (epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, _workers.Fd(), &ev) < 0) {
+		Debug("Add work eventfd to epoll failed");
+		Release();
 		return -1;
 	}
 
-	if (match_auth_code(head->auth_code, sizeof(head->auth_code)) < 0) {
-		return -1;
+	//定时器创建失败时合并窗口为0，参数设置立即下发。分片共用主reactor的合并器
+	if (_primary == NULL && _coalescer.Init() == 0) {
+		ev.events = EPOLLIN;
+		ev.data.ptr = &_coalescer;
+		epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, _coalescer.Fd(), &ev);
 	}
 
-	if (head->msg_size > (unsigned int)packet_len) {
-		return -1;
+	//UDP通道失败不影响TCP服务，只在主reactor中处理
+	if (_primary == NULL && _udp_enabled && _udp.Open(UDP_CONTROL_PORT) == 0) {
+		ev.events = EPOLLIN | EPOLLET;
+		ev.data.ptr = &_udp;
+		if (epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, _udp.Fd(), &ev) < 0) {
+			Debug("Add udp socket to epoll failed");
+			_udp.Close();
+		}
 	}
 
+	if (_primary == NULL && _shard_count > 1)
+		StartShards();
 	return 0;
 }
 
-int TcpServer::ProcessRequest(struct payload_req *req, char *buf)
+/**
+ * @function	int StartShards()
+ * @brief	创建并初始化其余分片reactor，全部初始化后再启动线程，
+ *		分片线程读取_shards时不会再有修改；初始化失败的分片不启动。
+ *		分片线程直接用pthread创建，StopShards可join后再删除
+ * @return	启动的分片数(含主reactor)
+ */
+int TcpServer::StartShards()
 {
-	Debug();
-	switch (req->type & 0xFF000000) {
+	int count = _shard_count;
+	for (int i = 1; i < count; i++) {
+		TcpServer *shard = new TcpServer(this, i);
+		if (shard->Init() < 0) {
+			Debug("init reactor shard %d failed", i);
+			delete shard;
+			continue;
+		}
+		_shards[i] = shard;
+	}
 
-	case REQ_TYPE_HEARTBEAT:
-		return ProcessHeartBeat(req, buf);
-		break;
-	case REQ_TYPE_MANUFACTURE:
-		return ProcessMannufacture(req, buf);
-		break;
-	case REQ_TYPE_CONTROL:
-		return ProcessControl(req);
-		break;
-	case REQ_TYPE_SET_PARAMETER:
-		return ProcessSetParameter(req, buf);
-		break;
-	case REQ_TYPE_GET_PARAMETER:
-		return ProcessGetParameter(req);
-		break;
-	default:
-		break;
+	int started = 1;
+	for (int i = 1; i < count; i++) {
+		TcpServer *shard = _shards[i];
+		if (shard == NULL)
+			continue;
+		if (pthread_create(&shard->_thread, NULL, ShardMain, shard) != 0) {
+			Debug("start reactor shard %d failed", i);
+			continue;
+		}
+		shard->_joinable = true;
+		started++;
 	}
 
-	return -1;
+	Debug("%d reactor shards started", started);
+	return started;
 }
 
-int TcpServer::ProcessAck(struct payload_ack *ack, char *buf)
+void *TcpServer::ShardMain(void *arg)
 {
-	ack = ack;
-	buf = buf;
-	return 0;
+	((TcpServer *)arg)->Run();
+	return NULL;
 }
 
-int TcpServer::ProcessHeartBeat(struct payload_req *req, char *buf)
+/**
+ * @function	void StopShards()
+ * @brief	通知所有分片退出并join其线程，全部退出后才删除，
+ *		避免仍在运行的分片向已删除的分片转发通知
+ */
+void TcpServer::StopShards()
 {
-	Debug();
-	req = req;
-	buf = buf;
-	return 0;
-}
+	if (_primary != NULL)
+		return;
 
+	for (int i = 1; i < _shard_count; i++) {
+		if (_shards[i] != NULL)
+			_shards[i]->Shutdown();
+	}
 
-int TcpServer::ProcessControl(struct payload_req *req)
-{
-	Debug();
-	switch (req->type & 0x00FF0000) {
-	case CTL_TYPE_VIDEO:
-		Sensor::GetInstance()->SetSensorVideo();
-		PeripherralManage::DisableRecv();
-		break;
-	case CTL_TYPE_CAPTURE:
-		Sensor::GetInstance()->SetSensorCapture();
-		PeripherralManage::EnableRecv();
-		break;
-	case CTL_TYPE_MANNUAL_SNAP:
-		GpioCtl::MannualSnap();
-		break;
-	case CTL_TYPE_REBOOT:
-		Util::Reboot();
-		break;
-	default:
-		break;
+	for (int i = 1; i < _shard_count; i++) {
+		if (_shards[i] == NULL || !_shards[i]->_joinable)
+			continue;
+		pthread_join(_shards[i]->_thread, NULL);
+		_shards[i]->_joinable = false;
 	}
-	
-	ReturnAck(req);
-	return 0;
-}
 
+	//分片的模式切换在本reactor的传感器工作线程中执行，完成后交回分片，
+	//工作线程执行完已提交的任务后才能释放分片
+	_workers.Shutdown();
 
-int TcpServer::ProcessSetParameter(struct payload_req *req, char *buf)
-{
-	Debug();
-	switch (req->type & REQ_TYPE_SUB_MASK) {
-	case PARAM_TYPE_CAMERA:
-		ProcessSetCameraParameter(req, buf);
-		break;
-	case PARAM_TYPE_NETWORK:
-		ProcessSetNetworkParam(buf);
-		break;
-	case PARAM_TYPE_UPLOAD:
-		ProcessSetUploadParam(buf);
-		break;
-	case PARAM_TYPE_TIME://添加校时模块
-		ProcessCalibrateTime(req, buf);
-		break;
-	case PARAM_TYPE_FLASH:
-		ProcessSetFlashParam(buf);
-		break;
-	case PARAM_TYPE_PLATE:
-		break;
-	case PARAM_TYPE_VIDEO_DETECT:
-		break;
-	case PARAM_TYPE_MANNUFACTURE:
-		break;
-	case PARAM_TYPE_DEVICE_INFO:
-		ProcessSetDeviceInfo(buf);
-		break;
-	default :
-		break;
-        }
-	
-	ReturnAck(req);
-        return 0;
+	for (int i = 1; i < _shard_count; i++) {
+		delete _shards[i];
+		_shards[i] = NULL;
+	}
 }
 
-int TcpServer::ProcessSetCameraParameter(struct payload_req *req, char *buf)
+/**
+ * @function	void Release()
+ * @brief	关闭所有客户端连接及监听、epoll句柄
+ *
+ */
+void TcpServer::Release()
 {
-	Debug();
-	CameraParam *setting = (CameraParam *)buf;
-	Parameters::GetInstance()->SetCameraParam(setting);
-
-	switch (req->type & REQ_TYPE_CMD_MASK) {
-	case PARAM_CAMERA_DEFAULT_GAIN:
-		Sensor::GetInstance()->SetSensorGain(setting->default_gain);
-		break;
-	case PARAM_CAMERA_MIN_GAIN:
-		Sensor::GetInstance()->SetSensorMinGain(setting->min_gain);
-		break;
-	case PARAM_CAMERA_MAX_GAIN:
-		Sensor::GetInstance()->SetSensorMaxGain(setting->max_gain);
-		break;
-	case PARAM_CAMERA_DEFAULT_EXPOSURE:
-		Sensor::GetInstance()->SetSensorExposure(setting->default_exposure);
-		break;
-	case PARAM_CAMERA_MIN_EXPOSURE:
-		Sensor::GetInstance()->SetSensorMinExp(setting->min_exposure);
-		break;
-	case PARAM_CAMERA_MAX_EXPOSURE:
-		Sensor::GetInstance()->SetSensorMaxExp(setting->max_exposure);
-		break;
-	case PARAM_CAMERA_RED_GAIN:
-		Sensor::GetInstance()->SetSensorRgain(setting->red_gain);
-		break;
-	case PARAM_CAMERA_BLUE_GAIN:
-		Sensor::GetInstance()->SetSensorBgain(setting->blue_gain);
-		break;
-	case PARAM_CAMERA_VIDEO_TARGET:
-		Sensor::GetInstance()->SetSensorVideoTargetGray(setting->video_target_gray);
-		break;
-	case PARAM_CAMERA_CAPTURE_TARGET:
-		Sensor::GetInstance()->SetSensorCaptureTargetGray(setting->trigger_target_gray);
-		break;
-	case PARAM_CAMERA_AEW_MODE:
-		switch (setting->aew_mode) {
-		case AEWMODE_DISABLE:
-			Sensor::GetInstance()->SetSensorAEManual();
-			break;
-		case AEWMODE_GAIN:
-			Sensor::GetInstance()->SetSensorAEAuto();
-			Sensor::GetInstance()->SetSensorAEMethod(0x01);
-			break;
-		case AEWMODE_EXP:
-			Sensor::GetInstance()->SetSensorAEAuto();
-			Sensor::GetInstance()->SetSensorAEMethod(0x02);
-			break;
-		case AEWMODE_AUTO:
-			Sensor::GetInstance()->SetSensorAEAuto();
-			Sensor::GetInstance()->SetSensorAEMethod(0x00);
-			break;
-		default:
-			break;
-		}
-		break;
-	default :
-		switch (setting->aew_mode) {
-			case AEWMODE_DISABLE:
-				Sensor::GetInstance()->SetSensorAEManual();
-				break;
-			case AEWMODE_GAIN:
-				Sensor::GetInstance()->SetSensorAEAuto();
-				Sensor::GetInstance()->SetSensorAEMethod(0x01);
-				break;
-			case AEWMODE_EXP:
-				Sensor::GetInstance()->SetSensorAEAuto();
-				Sensor::GetInstance()->SetSensorAEMethod(0x02);
-				break;
-			case AEWMODE_AUTO:
-				Sensor::GetInstance()->SetSensorAEAuto();
-				Sensor::GetInstance()->SetSensorAEMethod(0x00);
-				break;
-			default:
-				break;
-		}
+	StopShards();
 
-		Sensor::GetInstance()->SetSensorExposure(setting->default_exposure);
-		Sensor::GetInstance()->SetSensorMinExp(setting->min_exposure);
-		Sensor::GetInstance()->SetSensorMaxExp(setting->max_exposure);
-		Sensor::GetInstance()->SetSensorMinGain(setting->min_gain);
-		Sensor::GetInstance()->SetSensorMaxGain(setting->max_gain);
-		Sensor::GetInstance()->SetSensorGain(setting->default_gain);
-		Sensor::GetInstance()->SetSensorBgain(setting->blue_gain);
-		Sensor::GetInstance()->SetSensorRgain(setting->red_gain);
-		Sensor::GetInstance()->SetSensorVideoTargetGray(setting->video_target_gray);
-		Sensor::GetInstance()->SetSensorCaptureTargetGray(setting->trigger_target_gray);
-		Sensor::GetInstance()->SetSensorAEZone(setting->ae_zone);
-		break;
+	while (_conns != NULL) {
+		CloseClient(_conns);
 	}
+	_coalescer.Flush();
+	ParamStore::GetInstance()->Commit();
 
-	return 0;
+	//等待工作线程执行完已提交的任务，释放连接已断开的升级对象
+	_workers.Shutdown();
+	CompleteWork();
+	ReapClients();
+
+	//参数存储为进程内唯一，由主reactor在工作线程停止后关闭，
+	//此后不会再有设置写入日志
+	if (_primary == NULL)
+		ParamStore::GetInstance()->Shutdown();
+
+	if (server_sock >= 0) {
+		Socket::Close(server_sock);
+		server_sock = -1;
+	}
+	_udp.Close();
+	_ring.Release();
+	if (_epoll_fd >= 0) {
+		close(_epoll_fd);
+		_epoll_fd = -1;
+	}
+	if (_wakeup_fd >= 0) {
+		close(_wakeup_fd);
+		_wakeup_fd = -1;
+	}
+	if (_idle_fd >= 0) {
+		close(_idle_fd);
+		_idle_fd = -1;
+	}
 }
 
-int TcpServer::ProcessSetFlashParam(char *buf)
+/**
+ * @function	void Shutdown()
+ * @brief	唤醒reactor线程并使其退出，可在其他线程中调用
+ *
+ */
+void TcpServer::Shutdown()
 {
-	Debug();
-	FlashParam *setting = (FlashParam *)buf;
-	Parameters::GetInstance()->SetFlashParam(setting);
-
-	unsigned int mode = 0;
-	if (setting->flash_mode)
-		mode |= 0x01;
-	if (setting->led_mode)
-		mode |= 0x02;
-	if (setting->continuous_light)
-		mode |= 0x04;
-	Sensor::GetInstance()->SetSensorFlashMode(mode);
-
-	if (setting->redlight_sync_mode) {
-		Sensor::GetInstance()->SetSensorSyncOn();
-	} else {
-		Sensor::GetInstance()->SetSensorSyncOff();
+	if (_wakeup_fd >= 0) {
+		uint64_t one = 1;
+		ssize_t ret = write(_wakeup_fd, &one, sizeof(one));
+		ret = ret;
 	}
-
-	Sensor::GetInstance()->SetSensorFlashDelay(setting->flash_delay);
-	Sensor::GetInstance()->SetSensorRedLightDelay(setting->redlight_delay);
-	Sensor::GetInstance()->SetSensorRedLightEfficient(setting->redlight_efficient);
-	Sensor::GetInstance()->SetSensorLEDMultiple(setting->led_mutiple);
-
-	return 0;
 }
 
-int TcpServer::ProcessSetDeviceInfo(char *buf)
+/**
+ * @function	void Stop()
+ * @brief	包装Thread的停止: 先置终止标志，再唤醒阻塞在epoll_wait中的reactor，
+ *		reactor醒来后检查IsTerminated()退出
+ *
+ */
+void TcpServer::Stop()
 {
-	Debug();
-	DeviceInfo *setting = (DeviceInfo *)buf;
-	Parameters::GetInstance()->SetDeviceInfo(setting);
-
-	return 0;
+	Thread::Stop();
+	Shutdown();
 }
 
-int TcpServer::ProcessSetNetworkParam(char *buf)
+/**
+ * @function	void SetCoalesceWindow(unsigned int ms)
+ * @brief	设置相机/闪光灯参数合并窗口，0表示每次设置立即下发
+ *
+ */
+void TcpServer::SetCoalesceWindow(unsigned int ms)
 {
-	Debug();
-	
-	NetworkParam *setting = (NetworkParam *)buf;
-	Parameters::GetInstance()->SetNetworkParam(setting);
-	return 0;
+	_coalescer.SetWindow(ms);
 }
 
-int TcpServer::ProcessSetUploadParam(char *buf)
+/**
+ * @function	void SetShards(int count)
+ * @brief	在Start()之前调用: 启动count个reactor线程，各自用SO_REUSEPORT
+ *		监听39002端口，1为原有的单线程模式
+ *
+ */
+void TcpServer::SetShards(int count)
 {
-	Debug();
-	
-	UploadParam *setting = (UploadParam *)buf;
-	Parameters::GetInstance()->SetUploadParam(setting);
-
-	InitClient();
+	if (count < 1)
+		count = 1;
+	if (count > MAX_REACTOR_SHARDS)
+		count = MAX_REACTOR_SHARDS;
+	_shard_count = count;
+}
 
-	return 0;
+/**
+ * @function	void SetLowLatency(int rt_priority, int cpu, int busy_poll_us)
+ * @brief	手动抓拍低延迟设置，在Start()之前调用: reactor线程的实时优先级
+ *		和绑定CPU，以及客户端socket的忙轮询时间
+ *
+ */
+void TcpServer::SetLowLatency(int rt_priority, int cpu, int busy_poll_us)
+{
+	_rt_priority = rt_priority;
+	_rt_cpu = cpu;
+	_busy_poll_us = busy_poll_us;
 }
 
-int TcpServer::ProcessCalibrateTime(struct payload_req *req, char *buf)
+void TcpServer::ApplyRealtime()
 {
-	Ldczn_time *ldczn_time = (Ldczn_time *)buf;
+	if (_rt_cpu >= CPU_SETSIZE) {
+		Debug("reactor cpu %d out of range", _rt_cpu);
+	} else if (_rt_cpu >= 0) {
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		CPU_SET(_rt_cpu, &set);
+		if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+			Debug("bind reactor to cpu %d failed", _rt_cpu);
+	}
+
+	if (_rt_priority > 0) {
+		struct sched_param param;
+		memset(&param, 0, sizeof(param));
+		param.sched_priority = _rt_priority;
+		if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) != 0)
+			Debug("set reactor priority %d failed", _rt_priority);
+	}
+}
+
+void TcpServer::Run()
+{
+	//分片在主reactor中已初始化
+	if (_epoll_fd < 0 && Init() < 0) {
+		return;
+	}
+	ApplyRealtime();
+
+	struct epoll_event events[MAX_EPOLL_EVENTS];
+	bool quit = false;
+	while (!quit && !IsTerminated()) {
+		//无事件时一直阻塞，退出由Shutdown()/Stop()写_wakeup_fd唤醒
+		int n = epoll_wait(_epoll_fd, events, MAX_EPOLL_EVENTS, -1);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			Debug("epoll wait failed");
+			break;
+		}
+
+		//上一次处理时收到控制请求的连接排在前面处理，其余连接按就绪顺序处理
+		int order[MAX_EPOLL_EVENTS];
+		int prio = 0;
+		int clients = 0;
+		for (int i = 0; i < n; i++) {
+			void *ptr = events[i].data.ptr;
+			if (ptr == &server_sock) {
+				AcceptClients();
+			} else if (ptr == &_wakeup_fd) {
+				quit = true;
+			} else if (ptr == &_coalescer) {
+				_coalescer.OnTimer();
+			} else if (ptr == &_udp) {
+				HandleUdp();
+			} else if (ptr == &_workers) {
+				CompleteWork();
+			} else if (ptr == &_timers) {
+				ExpireTimers();
+			} else if (ptr == &_ring) {
+				ReapRing();
+			} else if (((TcpConnection *)ptr)->priority) {
+				//只优先一轮，之后再发控制请求才重新优先
+				((TcpConnection *)ptr)->priority = false;
+				memmove(order + prio + 1, order + prio, (clients - prio) * sizeof(int));
+				order[prio++] = i;
+				clients++;
+			} else {
+				order[clients++] = i;
+			}
+		}
+
+		memset(_admitted, 0, sizeof(_admitted));
+		for (int i = 0; i < clients; i++) {
+			struct epoll_event *ev = &events[order[i]];
+			_round_waiting = clients - i - 1;
+			HandleClient((TcpConnection *)ev->data.ptr, ev->events);
+		}
+		_round_waiting = 0;
+		ReapClients();
+	}
+
+	Release();
+}
+
+/**
+ * @function	void AcceptClients()
+ * @brief	边沿触发下循环accept直到EAGAIN，新连接加入epoll
+ *
+ */
+void TcpServer::AcceptClients()
+{
+	while (1) {
+		int sock = accept4(server_sock, NULL, NULL,
+				SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (sock < 0) {
+			if (errno == EINTR || errno == ECONNABORTED)
+				continue;
+			if ((errno == EMFILE || errno == ENFILE) && _idle_fd >= 0) {
+				//fd耗尽: 借用备用句柄接收并关闭该连接，避免边沿事件丢失
+				close(_idle_fd);
+				sock = accept(server_sock, NULL, NULL);
+				if (sock >= 0)
+					close(sock);
+				_idle_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+				Debug("too many open files, drop client");
+				continue;
+			}
+			break;
+		}
+
+		AddClient(sock);
+	}
+}
+
+/**
+ * @function	void AddClient(int sock)
+ * @brief	新连接(非阻塞)加入epoll和连接链表，开始空闲计时
+ *
+ */
+void TcpServer::AddClient(int sock)
+{
+	//应答小包立即发出，不等待Nagle合并
+	int on = 1;
+	setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+	if (_busy_poll_us > 0)
+		setsockopt(sock, SOL_SOCKET, SO_BUSY_POLL, &_busy_poll_us,
+			   sizeof(_busy_poll_us));
+
+	void *mem = _conn_slab.Alloc();
+	if (mem == NULL) {
+		Debug("no memory for client");
+		Socket::Close(sock);
+		return;
+	}
+
+	TcpConnection *conn = new (mem) TcpConnection(sock);
+	if (++_next_conn_id == 0)
+		_next_conn_id = 1;
+	conn->id = _next_conn_id;
+	struct epoll_event ev;
+	ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+	ev.data.ptr = conn;
+	if (epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, sock, &ev) < 0) {
+		Debug("Add client to epoll failed");
+		FreeClient(conn);
+		return;
+	}
+
+	conn->prev = NULL;
+	conn->next = _conns;
+	if (_conns != NULL)
+		_conns->prev = conn;
+	_conns = conn;
+
+	conn->last_rx = TimerWheel::Ticks();
+	_timers.Add(&conn->idle_timer, conn->last_rx +
+		    TimerWheel::MsToTicks(CONN_IDLE_TIMEOUT_MS));
+}
+
+/**
+ * @function	bool ArmAccept()
+ * @brief	提交multishot accept，之后每个新连接一个完成事件，不再逐个调用accept
+ * @return	false io_uring不可用
+ */
+bool TcpServer::ArmAccept()
+{
+	if (!_ring.Ready() ||
+	    _ring.PrepAccept(server_sock, SOCK_NONBLOCK | SOCK_CLOEXEC, true,
+			     RING_ACCEPT) < 0 ||
+	    _ring.Submit(0) < 0) {
+		_ring_accept = false;
+		return false;
+	}
+
+	_ring_accept = true;
+	return true;
+}
+
+/* 内核不支持multishot accept等情况，改回epoll监听 */
+void TcpServer::FallbackAccept()
+{
+	_ring_accept = false;
+
+	struct epoll_event ev;
+	ev.events = EPOLLIN | EPOLLET;
+	ev.data.ptr = &server_sock;
+	if (epoll_ctl(_epoll_fd, EPOLL_CTL_ADD, server_sock, &ev) < 0)
+		Debug("Add listen socket to epoll failed");
+	AcceptClients();
+}
+
+void TcpServer::AcceptRing(int res, bool more)
+{
+	if (res >= 0) {
+		AddClient(res);
+	} else if (res == -EINVAL) {
+		Debug("multishot accept unsupported, use epoll");
+		FallbackAccept();
+		return;
+	} else if ((res == -EMFILE || res == -ENFILE) && _idle_fd >= 0) {
+		close(_idle_fd);
+		int sock = accept(server_sock, NULL, NULL);
+		if (sock >= 0)
+			close(sock);
+		_idle_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+		Debug("too many open files, drop client");
+	}
+
+	if (!more && !ArmAccept())
+		FallbackAccept();
+}
+
+/**
+ * @function	void ReapRing()
+ * @brief	处理io_uring完成事件: 新连接加入reactor，发送完成时移出已发送的数据，
+ *		未发完的继续用sendmsg发送；-EAGAIN等待EPOLLOUT，其他错误由EPOLLERR关闭
+ */
+void TcpServer::ReapRing()
+{
+	unsigned long long data;
+	int res;
+	bool more;
+	while (_ring.Reap(&data, &res, &more)) {
+		if (data == RING_ACCEPT) {
+			if (_ring_accept)
+				AcceptRing(res, more);
+			continue;
+		}
+
+		TcpConnection *conn = (TcpConnection *)(unsigned long)data;
+		_ring_sends--;
+		if (conn->Fd() < 0)	//本轮已关闭
+			continue;
+		//-EAGAIN时socket已写满，由WatchWrite等待EPOLLOUT
+		if (res < 0 && res != -EAGAIN) {
+			Debug("client %u send failed, %s", conn->id, strerror(-res));
+			CloseClient(conn);
+			continue;
+		}
+		if (res > 0) {
+			conn->Sent(res);
+			if (conn->TxPending() && conn->Flush() < 0)
+				CloseClient(conn);
+		}
+	}
+}
+
+/* io_uring提交出错: 关闭后取消所有请求，之后按epoll方式工作 */
+void TcpServer::DisableRing()
+{
+	Debug("io_uring submit failed, fall back to epoll");
+	bool accept = _ring_accept;
+	_ring.Release();
+	_ring_sends = 0;
+	if (accept)
+		FallbackAccept();
+}
+
+/**
+ * @function	bool FlushBatched()
+ * @brief	用一次io_uring_enter发出所有待发送连接的输出队列，代替逐个sendmsg；
+ *		带MSG_DONTWAIT的发送在提交时即完成，返回前已全部处理
+ * @return	false io_uring不可用，由调用方逐个发送
+ */
+bool TcpServer::FlushBatched()
+{
+	if (!_ring.Ready())
+		return false;
+
+	//发送出错的连接在ReapRing中关闭，关闭的都是已提交的(链表中在前)，先取下一个
+	TcpConnection *next;
+	_ring_sends = 0;
+	for (TcpConnection *conn = _conns; conn != NULL; conn = next) {
+		next = conn->next;
+		if (!conn->TxPending())
+			continue;
+
+		if (_ring.PrepSendmsg(conn->Fd(), conn->TxMsg(), MSG_NOSIGNAL |
+				      MSG_DONTWAIT, (unsigned long)conn) < 0) {
+			//提交队列已满，先发出已填写的部分
+			if (_ring.Submit(_ring_sends) < 0) {
+				DisableRing();
+				return false;
+			}
+			ReapRing();
+			if (_ring.PrepSendmsg(conn->Fd(), conn->TxMsg(), MSG_NOSIGNAL |
+					      MSG_DONTWAIT, (unsigned long)conn) < 0) {
+				//仍无法提交，按epoll方式发送，未发完的等待EPOLLOUT
+				if (conn->Flush() < 0)
+					CloseClient(conn);
+				else
+					WatchWrite(conn);
+				continue;
+			}
+		}
+		_ring_sends++;
+	}
+
+	while (_ring_sends > 0) {
+		if (_ring.Submit(_ring_sends) < 0) {
+			DisableRing();
+			return false;
+		}
+		ReapRing();
+	}
+
+	for (TcpConnection *conn = _conns; conn != NULL; conn = conn->next)
+		WatchWrite(conn);
+	return true;
+}
+
+/**
+ * @function	void HandleClient(TcpConnection *conn, unsigned int events)
+ * @brief	读取客户端数据直到EAGAIN并逐帧分发，本次产生的应答一次性发出；
+ *		输出队列积压时暂停读取，待EPOLLOUT排空后再继续
+ *
+ */
+void TcpServer::HandleClient(TcpConnection *conn, unsigned int events)
+{
+	bool alive = true;
+	bool eof = false;
+
+	if (conn->Fd() < 0)	//本轮已关闭，等待释放
+		return;
+
+	if ((events & EPOLLOUT) && conn->Flush() < 0)
+		alive = false;
+
+	while (alive && !eof) {
+		bool again = false;
+		if (conn->TxDrained()) {
+			while (!conn->TxBlocked()) {
+				if (conn->InExchange()) {
+					int ret = RunExchange(conn);
+					if (ret == EX_CLOSE) {
+						eof = true;
+						break;
+					}
+					//等待数据、写盘或工作线程，由对应事件重新调用
+					if (ret == EX_WAIT) {
+						again = true;
+						break;
+					}
+					continue;
+				}
+
+				int ret = conn->Fill();
+				if (ProcessFrames(conn) < 0) {
+					alive = false;
+					break;
+				}
+				if (ret == CONN_FILL_CLOSED) {
+					eof = true;
+					break;
+				}
+				//请求开始了交互，先由交互处理已读入的数据
+				if (conn->InExchange())
+					continue;
+				if (ret == CONN_FILL_AGAIN) {
+					again = true;
+					break;
+				}
+			}
+		}
+
+		//本批设置落盘后再发送应答和通知
+		ParamStore::GetInstance()->Commit();
+		if (_notify_pending)
+			FlushNotified();
+		if (conn->Fd() < 0)	//批量发送出错已关闭
+			return;
+		if (alive && conn->Flush() < 0)
+			alive = false;
+
+		//已读空或socket写满(等待EPOLLOUT)时结束，否则队列已排空，继续处理积压请求
+		if (!alive || eof || again || conn->TxPending())
+			break;
+	}
+
+	if (!alive || eof || (events & (EPOLLHUP | EPOLLERR))) {
+		CloseClient(conn);
+		return;
+	}
+	WatchWrite(conn);
+}
+
+/**
+ * @function	int ProcessFrames(TcpConnection *conn)
+ * @brief	按header_std.msg_size从接收缓冲中切分完整帧并原地解析，
+ *		不完整的帧留待下次读取
+ * @return	0成功，-1协议错误需关闭连接
+ */
+int TcpServer::ProcessFrames(TcpConnection *conn)
+{
+	FireSnaps(conn);
+
+	while (conn->DataLen() >= sizeof(struct header_std) && !conn->TxBlocked() &&
+	       !conn->InExchange()) {
+		conn->Align();
+
+		struct header_std *head = (struct header_std *)conn->Data();
+		unsigned int size = head->msg_size;
+		if (size < sizeof(struct header_std) || size > conn->Capacity()) {
+			Debug("bad packet size %u", size);
+			return -1;
+		}
+		if (conn->DataLen() < size)
+			break;
+
+		//先移出本帧，使处理函数通过conn->Read()读到的是帧后的数据
+		char *frame = conn->Data();
+		conn->snap_fired = conn->snap_scan > 0;
+		conn->Consume(size);
+
+		if (size < sizeof(PacketRequest)) {
+			Debug("got %u packet, buf too less packet", size);
+			continue;
+		}
+
+		clnt_sock = conn->Fd();
+		_current = conn;
+		int ret = 0;
+		if (Admit(frame))
+			ret = ParsePacket(frame, size);
+		//应答已拷贝到发送缓冲，临时内存不跨帧使用
+		conn->ResetScratch();
+		_current = NULL;
+		clnt_sock = -1;
+		if (ret < 0)
+			return -1;
+	}
+
+	return 0;
+}
+
+/**
+ * @function	void FireSnaps(TcpConnection *conn)
+ * @brief	在按顺序处理本批请求之前先触发其中的手动抓拍，抓拍不必排在
+ *		参数设置、落盘之后；应答仍按请求顺序在触发后发送。
+ *		帧头校验与ProcessHeader相同，遇到其他控制请求(模式切换、重启)即停止，
+ *		抓拍不越过它们执行
+ *
+ */
+void TcpServer::FireSnaps(TcpConnection *conn)
+{
+	char *data = conn->Data();
+	unsigned int len = conn->DataLen();
+	unsigned int off = conn->snap_scan;	//之前扫描过的帧不再触发
+
+	if (conn->InExchange())
+		return;
+
+	while (len - off >= sizeof(PacketRequest)) {
+		//帧可能未对齐，按字节拷出
+		struct header_std head;
+		memcpy(&head, data + off, sizeof(head));
+		if (ProcessHeader(&head, len - off) != 0 || head.msg_size < sizeof(head))
+			break;
+
+		if (head.msg_type == MESSAGE_TYPE_REQ &&
+		    head.msg_size >= sizeof(PacketRequest)) {
+			struct payload_req req;
+			char *p = data + off + sizeof(head);
+			memcpy(&req, p, sizeof(req));
+			//升级请求之后可能是文件流而不是请求帧，不再向后扫描
+			if ((req.type & 0xFF000000) == REQ_TYPE_MANUFACTURE)
+				break;
+			if ((req.type & 0xFF000000) == REQ_TYPE_CONTROL) {
+				//模式切换、重启须按顺序执行，其后的抓拍不提前
+				if ((req.type & 0x00FF0000) != CTL_TYPE_MANNUAL_SNAP)
+					break;
+				fire_snap();
+			}
+		}
+
+		off += head.msg_size;
+		conn->snap_scan = off;
+	}
+}
+
+/**
+ * @function	void HandleUdp()
+ * @brief	处理UDP通道上的心跳和手动抓拍，其他请求回复不支持。
+ *		重复序号不再执行，只重发应答；早于窗口的报文丢弃
+ *
+ */
+void TcpServer::HandleUdp()
+{
+	char buf[RECV_BUF_LENGTH] __attribute__((aligned(8)));
+	struct sockaddr_in from;
+
+	while (1) {
+		int len = _udp.Recv(buf, sizeof(buf), &from);
+		if (len <= 0)
+			break;
+
+		struct header_std *head = (struct header_std *)buf;
+		if ((unsigned int)len < sizeof(PacketRequest) ||
+		    ProcessHeader(head, len) || head->msg_type != MESSAGE_TYPE_REQ)
+			continue;
+
+		struct payload_req *req = (struct payload_req *)(head + 1);
+		bool snap = (req->type & 0xFF000000) == REQ_TYPE_CONTROL &&
+			    (req->type & 0x00FF0000) == CTL_TYPE_MANNUAL_SNAP;
+		bool heartbeat = (req->type & 0xFF000000) == REQ_TYPE_HEARTBEAT;
+
+		unsigned int status = ACK_SUCCESS;
+		if (!snap && !heartbeat) {
+			status = ACK_EXT_UNSUPPORTED;
+		} else {
+			int ret = _udp.Check(&from, req->id);
+			if (ret == UDP_SEQ_STALE) {
+				Debug("drop stale udp seq %u", req->id);
+				continue;
+			}
+			if (ret == UDP_SEQ_NEW && snap)
+				fire_snap();
+		}
+
+		struct packet_ack packet;
+		ack_fill(&packet, req->id, req->type, status);
+
+		_udp.Reply(&from, (char *)&packet, sizeof(packet));
+	}
+}
+
+/**
+ * @function	bool Admit(char *frame)
+ * @brief	按请求类别准入: 本轮还有其他连接等待且该类已达上限时回复忙，
+ *		控制类请求不受限制，并使其连接在下一轮中优先处理一次
+ * @return	true继续处理，false已回复忙
+ */
+bool TcpServer::Admit(char *frame)
+{
+	struct header_std *head = (struct header_std *)frame;
+	if (head->msg_type != MESSAGE_TYPE_REQ)
+		return true;
+
+	struct payload_req *req = (struct payload_req *)(head + 1);
+	int index = _requests.Lookup(req->type);
+	int klass = index != 0 ? _requests.Handler(index)->klass : REQ_CLASS_CONTROL;
+	if (klass == REQ_CLASS_CONTROL) {
+		if ((req->type & 0xFF000000) == REQ_TYPE_CONTROL)
+			_current->priority = true;
+		return true;
+	}
+
+	if (_round_waiting == 0 || _admitted[klass] < class_budget[klass]) {
+		_admitted[klass]++;
+		return true;
+	}
+
+	struct packet_ack packet;
+	ack_fill(&packet, req->id, req->type, ACK_EXT_BUSY);
+
+	SendToClient((char *)&packet, sizeof(packet));
+	return false;
+}
+
+void TcpServer::CloseClient(TcpConnection *conn)
+{
+	//发送出错时可能已在FlushBatched中关闭
+	if (conn->Fd() < 0)
+		return;
+
+	if (conn->prev != NULL)
+		conn->prev->next = conn->next;
+	else
+		_conns = conn->next;
+	if (conn->next != NULL)
+		conn->next->prev = conn->prev;
+
+	if (_epoll_fd >= 0 && conn->Fd() >= 0)
+		epoll_ctl(_epoll_fd, EPOLL_CTL_DEL, conn->Fd(), NULL);
+	_timers.Del(&conn->idle_timer);
+	_timers.Del(&conn->write_timer);
+	_timers.Del(&conn->exchange.timer);
+	DropUpgrade(conn);
+	conn->Close();
+
+	//同一轮epoll事件中可能还有该连接的事件，处理完本轮后再释放
+	conn->prev = NULL;
+	conn->next = _closed;
+	_closed = conn;
+}
+
+void TcpServer::ReapClients()
+{
+	while (_closed != NULL) {
+		TcpConnection *conn = _closed;
+		_closed = conn->next;
+		FreeClient(conn);
+	}
+}
+
+void TcpServer::FreeClient(TcpConnection *conn)
+{
+	conn->~TcpConnection();
+	_conn_slab.Free(conn);
+}
+
+TcpConnection *TcpServer::FindClient(unsigned int id)
+{
+	for (TcpConnection *conn = _conns; conn != NULL; conn = conn->next) {
+		if (conn->id == id)
+			return conn;
+	}
+	return NULL;
+}
+
+/**
+ * @function	bool SelectClient(unsigned int id)
+ * @brief	将异步应答的目标设为连接id，连接已断开时返回false
+ *
+ */
+bool TcpServer::SelectClient(unsigned int id)
+{
+	TcpConnection *conn = id != 0 ? FindClient(id) : NULL;
+	_current = conn;
+	clnt_sock = conn != NULL ? conn->Fd() : -1;
+	if (conn != NULL)
+		_notify_pending = true;
+	return conn != NULL;
+}
+
+/**
+ * @function	void DropUpgrade(TcpConnection *conn)
+ * @brief	连接放弃升级对象，有写盘任务未完成时由最后一个任务的完成处理删除
+ *
+ */
+void TcpServer::DropUpgrade(TcpConnection *conn)
+{
+	UpgradeReceiver *receiver = conn->upgrade;
+	conn->upgrade = NULL;
+	if (receiver == NULL)
+		return;
+
+	if (receiver->Busy())
+		receiver->Orphan();
+	else
+		delete receiver;
+}
+
+
+static inline int get_auth_code(char *auth_code, int len)
+{
+	auth_code = auth_code;
+	len = len;
+	return 0;
+}
+
+static inline int match_auth_code(const char *auth_code, int len)
+{
+	auth_code = auth_code;
+	len = len;
+	return 0;
+}
+
+
+/**
+ * @function	int UpgradeExchange(TcpConnection *conn, struct Exchange *ex)
+ * @brief	升级文件流: 先取走连接缓冲中的数据，再直接从socket读入写盘，
+ *		收满total_length后安装并应答；数据中断超过UPGRADE_STALL_MS断开
+ * @return	EX_DONE/EX_WAIT/EX_CLOSE
+ */
+int TcpServer::UpgradeExchange(TcpConnection *conn, struct Exchange *ex)
+{
+	UpgradeReceiver *receiver = conn->upgrade;
+	unsigned int received;
+	int ret;
+
+	EX_BEGIN(ex);
+	while (!receiver->Done()) {
+		conn->Consume(receiver->Feed(conn->Data(), conn->DataLen()));
+		if (!receiver->Done() && conn->DataLen() > 0) {
+			//两个缓冲都在写盘，写盘完成后由CompleteWork继续
+			_timers.Del(&ex->timer);
+			EX_YIELD(ex);
+			continue;
+		}
+
+		received = receiver->Received();
+		ret = receiver->Done() ? UPGRADE_RECV_DONE : receiver->Receive(conn->Fd());
+		if (receiver->Received() != received)
+			conn->last_rx = TimerWheel::Ticks();
+		if (ret == UPGRADE_RECV_CLOSED)
+			return EX_CLOSE;
+		if (ret == UPGRADE_RECV_AGAIN || ret == UPGRADE_RECV_BUSY) {
+			if (ret == UPGRADE_RECV_AGAIN)
+				ExpectWithin(conn, UPGRADE_STALL_MS);
+			else
+				_timers.Del(&ex->timer);
+			EX_YIELD(ex);
+			if (ex->expired) {
+				Debug("upgrade stream stalled, %u of %u bytes",
+				      conn->upgrade->Received(), conn->upgrade->Total());
+				return EX_CLOSE;
+			}
+		}
+	}
+
+	//安装完成后才应答并继续解析后续请求，应答保持请求顺序
+	conn->upgrade = NULL;
+	ex->wait_work = WORK_UPGRADE_FINISH;
+	_timers.Del(&ex->timer);
+	receiver->PostFinish(NULL, receiver->Verify(), receiver->ExpectedCrc());
+	EX_WAIT_UNTIL(ex, ex->work != NULL);
+	if (ex->work != NULL)
+		ReplyWork(ex->work);
+	EX_END(ex);
+}
+
+/**
+ * @function	int TimeExchange(TcpConnection *conn, struct Exchange *ex)
+ * @brief	校时: 等待工作线程设置完系统时间后应答，超时回复失败；
+ *		等待期间该连接的后续请求不处理，应答保持请求顺序
+ */
+int TcpServer::TimeExchange(TcpConnection *conn, struct Exchange *ex)
+{
+	EX_BEGIN(ex);
+	ExpectWithin(conn, TIME_CALIBRATE_MS);
+	EX_WAIT_UNTIL(ex, ex->work != NULL);
+
+	{
+		struct packet_man_comp_time_ack packet;
+		if (ex->work != NULL) {
+			ack_fill(&packet, 0, ex->req.type, ACK_SUCCESS);
+			memcpy(&packet.time, ex->work->data, sizeof(packet.time));
+		} else {
+			Debug("calibrate time timeout on client %u", conn->id);
+			ack_fill(&packet, 0, ex->req.type, ACK_EXT_FAILED);
+			memset(&packet.time, 0, sizeof(packet.time));
+		}
+		SendToClient((char *)&packet, sizeof(packet));
+	}
+	//与原有顺序一致，校时应答之后再回通用应答
+	ReturnAck(&ex->req);
+	EX_END(ex);
+}
+
+void TcpServer::StartExchange(TcpConnection *conn, int type,
+			      const struct payload_req *req)
+{
+	struct Exchange *ex = &conn->exchange;
+	ex->type = type;
+	ex->line = 0;
+	ex->expired = false;
+	ex->wait_work = -1;
+	ex->work = NULL;
+	if (req != NULL)
+		ex->req = *req;
+}
+
+/**
+ * @function	void WaitWork(struct payload_req *req, int work_type)
+ * @brief	当前请求的应答在work_type任务完成后给出，期间该连接的后续请求
+ *		不处理，应答保持请求顺序。工作线程总会执行完任务，不设期限
+ *
+ */
+void TcpServer::WaitWork(struct payload_req *req, int work_type)
+{
+	if (_current == NULL)
+		return;
+
+	StartExchange(_current, EXCHANGE_WORK, req);
+	_current->exchange.wait_work = work_type;
+}
+
+int TcpServer::WorkExchange(TcpConnection *conn, struct Exchange *ex)
+{
+	conn = conn;
+	EX_BEGIN(ex);
+	EX_WAIT_UNTIL(ex, ex->work != NULL);
+	if (ex->work != NULL)
+		ReplyWork(ex->work);
+	EX_END(ex);
+}
+
+/**
+ * @function	bool DeliverWork(struct Work *work)
+ * @brief	把完成的任务交给等待它的连接交互继续执行
+ * @return	true已交给交互，false连接已断开或交互不在等待该类任务
+ */
+bool TcpServer::DeliverWork(struct Work *work)
+{
+	TcpConnection *conn = work->conn_id != 0 ? FindClient(work->conn_id) : NULL;
+	if (conn == NULL || !conn->InExchange() ||
+	    conn->exchange.wait_work != work->type)
+		return false;
+
+	conn->exchange.work = work;
+	HandleClient(conn, 0);
+	conn->exchange.work = NULL;
+	return true;
+}
+
+/* 由等待任务的交互调用，_current为发起请求的连接 */
+void TcpServer::ReplyWork(struct Work *work)
+{
+	switch (work->type) {
+	case WORK_MODE:
+	case WORK_REBOOT:
+		ReturnAck(&work->req);
+		break;
+	case WORK_UPGRADE_OPEN: {
+		UpgradeReceiver *receiver = (UpgradeReceiver *)work->arg;
+		ReturnUpgradeProgress(&work->req, work->result < 0 ?
+				      ACK_EXT_FAILED : ACK_SUCCESS, receiver);
+		//续接失败，连接放弃接收对象，下次RESUME重新打开
+		if (work->result < 0 && _current != NULL && _current->upgrade == receiver)
+			DropUpgrade(_current);
+		break;
+	}
+	case WORK_UPGRADE_SYNC:
+		ReturnUpgradeProgress(&work->req, work->result < 0 ?
+				      ACK_EXT_FAILED : ACK_SUCCESS,
+				      (UpgradeReceiver *)work->arg);
+		break;
+	case WORK_UPGRADE_FINISH: {
+		unsigned int status = ACK_SUCCESS;
+		if (work->result == -2)
+			status = ACK_EXT_CRC_MISMATCH;
+		else if (work->result < 0)
+			status = ACK_EXT_FAILED;
+		ReturnUpgradeAck(work->req.type, status, (UpgradeReceiver *)work->arg);
+		break;
+	}
+	default:
+		break;
+	}
+}
+
+/**
+ * @function	int RunExchange(TcpConnection *conn)
+ * @brief	从上次等待处继续连接上的交互，结束后恢复按请求帧解析
+ * @return	EX_DONE/EX_WAIT/EX_CLOSE
+ */
+int TcpServer::RunExchange(TcpConnection *conn)
+{
+	struct Exchange *ex = &conn->exchange;
+	int ret = EX_DONE;
+
+	_current = conn;
+	clnt_sock = conn->Fd();
+	switch (ex->type) {
+	case EXCHANGE_UPGRADE:
+		ret = UpgradeExchange(conn, ex);
+		break;
+	case EXCHANGE_TIME:
+		ret = TimeExchange(conn, ex);
+		break;
+	case EXCHANGE_WORK:
+		ret = WorkExchange(conn, ex);
+		break;
+	default:
+		break;
+	}
+	_current = NULL;
+	clnt_sock = -1;
+
+	ex->expired = false;
+	if (ret != EX_WAIT) {
+		_timers.Del(&ex->timer);
+		ex->type = EXCHANGE_NONE;
+		ex->line = 0;
+	}
+	return ret;
+}
+
+/* 本次等待的期限，到期后以expired重新调用交互 */
+void TcpServer::ExpectWithin(TcpConnection *conn, unsigned int ms)
+{
+	_timers.Add(&conn->exchange.timer, TimerWheel::Ticks() +
+		    TimerWheel::MsToTicks(ms));
+}
+
+/**
+ * @function	int SendToClient(char *buf, int len)
+ * @brief	应答包按请求顺序进入当前连接的输出队列，由reactor批量发送
+ *
+ */
+int TcpServer::SendToClient(char *buf, int len)
+{
+	Debug();
+	if (_current == NULL)
+		return Socket::Writen(clnt_sock, buf, len, 2000);
+
+	if (_current->Send(buf, len) < 0) {
+		Debug("output queue overflow");
+		return -1;
+	}
+	return len;
+}
+
+/**
+ * @function	int SendShared(char *head, int head_len, struct TxBuffer *buf,
+ *			       unsigned int off, unsigned int len)
+ * @brief	发送拷贝的包头和共享缓冲中的包体，包体不拷贝，由输出队列引用
+ *
+ */
+int TcpServer::SendShared(char *head, int head_len, struct TxBuffer *buf,
+			  unsigned int off, unsigned int len)
+{
+	Debug();
+	if (_current == NULL) {
+		if (Socket::Writen(clnt_sock, head, head_len, 2000) != head_len)
+			return -1;
+		return Socket::Writen(clnt_sock, buf->data + off, len, 2000);
+	}
+
+	if (_current->Send(head, head_len) < 0 ||
+	    _current->Enqueue(buf, off, len) < 0) {
+		Debug("output queue overflow");
+		return -1;
+	}
+	return head_len + len;
+}
+
+
+int TcpServer::ParsePacket(char *buf, int len)
+{
+	if ((unsigned int)len < sizeof(struct header_std)) {
+		return -1;
+	}
+	
+	struct header_std *head = (struct header_std *)buf;
+	if (ProcessHeader(head, len)) {
+		return -1;
+	}
+	_payload_end = buf + head->msg_size;
+
+	switch (head->msg_type) {
+	case MESSAGE_TYPE_REQ:
+		ProcessRequest((struct payload_req *)(buf + sizeof(*head)),
+				buf + sizeof(*head) + sizeof(struct payload_req));
+		break;
+	case MESSAGE_TYPE_ACK:
+		ProcessAck((struct payload_ack *)(buf + sizeof(*head)),
+				buf + sizeof(*head) + sizeof(struct payload_ack));
+		break;
+	default:
+		break;
+	}
+
+	return len - head->msg_size;
+}
+
+int TcpServer::ProcessHeader(struct header_std *head, int packet_len)
+{
+	const char magic[sizeof(head->magic)] = PROTOCOL_MAGIC;
+	Debug();
+
+	if (memcmp(head->magic, magic, sizeof(magic)) != 0) {
+		return -1;
+	}
+
+	if ((head->protocol_major != PROTOCOL_MAJOR) ||
+		(head->protocol_minor != PROTOCOL_MINOR)) {
+		return -1;
+	}
+
+	if (head->encoding != ENCODING_TYPE_RAW) {
+		return -1;
+	}
+
+	if (match_auth_code(head->auth_code, sizeof(head->auth_code)) < 0) {
+		return -1;
+	}
+
+	if (head->msg_size > (unsigned int)packet_len) {
+		return -1;
+	}
+
+	return 0;
+}
+
+/**
+ * @function	int ProcessRequest(struct payload_req *req, char *buf)
+ * @brief	按分发表调用处理函数，定长负载在此检查一次，不足时回复长度错误；
+ *		未注册的类型不应答
+ *
+ */
+int TcpServer::ProcessRequest(struct payload_req *req, char *buf)
+{
+	Debug();
+	int index = _requests.Lookup(req->type);
+	if (index == 0) {
+		_requests.Miss();
+		return -1;
+	}
+
+	const struct RequestHandler *handler = _requests.Handler(index);
+	if (buf > _payload_end ||
+	    (unsigned int)(_payload_end - buf) < handler->payload) {
+		_requests.Short(index);
+		Debug("%s: short payload", handler->name);
+		ReturnStatus(req, ACK_EXT_BAD_LENGTH);
+		return -1;
+	}
+	_requests.Hit(index);
+
+	if (handler->flags & REQ_FLAG_CACHED)
+		return ReturnCachedAck(req, handler->group);
+
+	int ret = 0;
+	if (handler->fn != NULL)
+		ret = (this->*handler->fn)(req, buf);
+
+	if (handler->flags & REQ_FLAG_ACK) {
+		//参数未能写入日志时回复失败，不发变化通知
+		if (ret < 0) {
+			ReturnStatus(req, ACK_EXT_FAILED);
+			return 0;
+		}
+		ReturnAck(req);
+		if (handler->group >= 0)
+			NotifyParam(handler->group);
+		return 0;
+	}
+	return ret;
+}
+
+int TcpServer::ProcessAck(struct payload_ack *ack, char *buf)
+{
+	ack = ack;
+	buf = buf;
+	return 0;
+}
+
+/**
+ * @function	int ProcessHeartBeat(struct payload_req *req, char *buf)
+ * @brief	连接改按心跳超时判断存活(收到数据时已刷新)，应答带设备时间
+ *
+ */
+int TcpServer::ProcessHeartBeat(struct payload_req *req, char *buf)
+{
+	Debug();
+	buf = buf;
+	if (_current != NULL)
+		_current->heartbeat = true;
+
+	struct packet_heartbeat_ack packet;
+	ack_fill(&packet, req->id, req->type, ACK_SUCCESS);
+
+	struct timeval tv;
+	struct timespec ts;
+	gettimeofday(&tv, NULL);
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	packet.time.sec		= tv.tv_sec;
+	packet.time.usec	= tv.tv_usec;
+	packet.time.uptime_ms	= ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+	packet.time.timeout_ms	= CONN_HEARTBEAT_TIMEOUT_MS;
+
+	return SendToClient((char *)&packet, sizeof(packet));
+}
+
+
+static void mode_job(struct Work *work)
+{
+	SensorShadow *shadow = (SensorShadow *)work->arg;
+	shadow->Lock();
+	if (work->value == CTL_TYPE_VIDEO) {
+		Sensor::GetInstance()->SetSensorVideo();
+		PeripherralManage::DisableRecv();
+	} else {
+		Sensor::GetInstance()->SetSensorCapture();
+		PeripherralManage::EnableRecv();
+	}
+	shadow->Invalidate();
+	shadow->Unlock();
+}
+
+static void reboot_job(struct Work *work)
+{
+	work = work;
+	Util::Reboot();
+}
+
+int TcpServer::ProcessControl(struct payload_req *req, char *buf)
+{
+	Debug();
+	buf = buf;
+	struct Work *work = NULL;	//在工作线程中执行的操作
+	switch (req->type & 0x00FF0000) {
+	case CTL_TYPE_VIDEO:
+	case CTL_TYPE_CAPTURE:
+		//模式切换与参数下发在同一工作线程中按顺序执行，完成后应答
+		work = WorkPool::Alloc(WORK_CLASS_SENSOR, WORK_MODE, mode_job);
+		work->value = req->type & 0x00FF0000;
+		work->arg   = _shadow;
+		break;
+	case CTL_TYPE_MANNUAL_SNAP:
+		//已在FireSnaps中触发的只应答
+		if (_current == NULL || !_current->snap_fired)
+			fire_snap();
+		break;
+	case CTL_TYPE_REBOOT:
+		work = WorkPool::Alloc(WORK_CLASS_SYSTEM, WORK_REBOOT, reboot_job);
+		break;
+	default:
+		break;
+	}
+
+	if (work != NULL) {
+		work->conn_id = _current != NULL ? _current->id : 0;
+		work->req     = *req;
+		WaitWork(req, work->type);
+		if (work->klass == WORK_CLASS_SENSOR) {
+			//主reactor的传感器工作线程执行，完成后交回本reactor应答
+			work->owner = &_workers;
+			_sensor_host->_workers.Post(work);
+		} else {
+			_workers.Post(work);
+		}
+		return 0;
+	}
+	
+	ReturnAck(req);
+	return 0;
+}
+
+
+int TcpServer::ProcessSetCameraParameter(struct payload_req *req, char *buf)
+{
+	Debug();
+	CameraParam copy;
+	const CameraParam *setting = payload_view(buf, _payload_end, &copy);
+	if (setting == NULL)
+		return -1;
+	if (ParamStore::GetInstance()->SetCameraParam(setting) < 0)
+		return -1;
+
+	unsigned int fields;
+	switch (req->type & REQ_TYPE_CMD_MASK) {
+	case PARAM_CAMERA_DEFAULT_GAIN:
+		fields = CAMERA_FIELD_DEFAULT_GAIN;
+		break;
+	case PARAM_CAMERA_MIN_GAIN:
+		fields = CAMERA_FIELD_MIN_GAIN;
+		break;
+	case PARAM_CAMERA_MAX_GAIN:
+		fields = CAMERA_FIELD_MAX_GAIN;
+		break;
+	case PARAM_CAMERA_DEFAULT_EXPOSURE:
+		fields = CAMERA_FIELD_DEFAULT_EXPOSURE;
+		break;
+	case PARAM_CAMERA_MIN_EXPOSURE:
+		fields = CAMERA_FIELD_MIN_EXPOSURE;
+		break;
+	case PARAM_CAMERA_MAX_EXPOSURE:
+		fields = CAMERA_FIELD_MAX_EXPOSURE;
+		break;
+	case PARAM_CAMERA_RED_GAIN:
+		fields = CAMERA_FIELD_RED_GAIN;
+		break;
+	case PARAM_CAMERA_BLUE_GAIN:
+		fields = CAMERA_FIELD_BLUE_GAIN;
+		break;
+	case PARAM_CAMERA_VIDEO_TARGET:
+		fields = CAMERA_FIELD_VIDEO_TARGET;
+		break;
+	case PARAM_CAMERA_CAPTURE_TARGET:
+		fields = CAMERA_FIELD_CAPTURE_TARGET;
+		break;
+	case PARAM_CAMERA_AEW_MODE:
+		fields = CAMERA_FIELD_AEW_MODE;
+		break;
+	default :
+		fields = CAMERA_FIELD_ALL;
+		break;
+	}
+
+	//合并窗口内的连续设置，下发时只写与上次不同的字段
+	_sensor_host->_coalescer.SetCamera(fields);
+
+	return 0;
+}
+
+int TcpServer::ProcessSetFlashParam(struct payload_req *req, char *buf)
+{
+	Debug();
+	req = req;
+	FlashParam copy;
+	const FlashParam *setting = payload_view(buf, _payload_end, &copy);
+	if (setting == NULL)
+		return -1;
+	if (ParamStore::GetInstance()->SetFlashParam(setting) < 0)
+		return -1;
+	_sensor_host->_coalescer.SetFlash();
+
+	return 0;
+}
+
+int TcpServer::ProcessSetDeviceInfo(struct payload_req *req, char *buf)
+{
+	Debug();
+	req = req;
+	DeviceInfo copy;
+	const DeviceInfo *setting = payload_view(buf, _payload_end, &copy);
+	if (setting == NULL)
+		return -1;
+	if (ParamStore::GetInstance()->SetDeviceInfo(setting) < 0)
+		return -1;
+
+	return 0;
+}
+
+int TcpServer::ProcessSetNetworkParam(struct payload_req *req, char *buf)
+{
+	Debug();
+	req = req;
+
+	NetworkParam copy;
+	const NetworkParam *setting = payload_view(buf, _payload_end, &copy);
+	if (setting == NULL)
+		return -1;
+	if (ParamStore::GetInstance()->SetNetworkParam(setting) < 0)
+		return -1;
+	return 0;
+}
+
+int TcpServer::ProcessSetUploadParam(struct payload_req *req, char *buf)
+{
+	Debug();
+	req = req;
+
+	UploadParam copy;
+	const UploadParam *setting = payload_view(buf, _payload_end, &copy);
+	if (setting == NULL)
+		return -1;
+	if (ParamStore::GetInstance()->SetUploadParam(setting) < 0)
+		return -1;
+
+	InitClient();
+
+	return 0;
+}
+
+int TcpServer::ProcessCalibrateTime(struct payload_req *req, char *buf)
+{
+	Ldczn_time copy;
+	const Ldczn_time *ldczn_time = payload_view(buf, _payload_end, &copy);
+	if (ldczn_time == NULL)
+		return -1;
+	PostCalibrateTime(ldczn_time, req);
+	if (_current != NULL) {
+		StartExchange(_current, EXCHANGE_TIME, req);
+		_current->exchange.wait_work = WORK_TIME;
+	}
+	return 0;	
+}
+
+static void time_job(struct Work *work)
+{
+	Ldczn_time *ldczn_time = (Ldczn_time *)work->data;
 	char timestr[20];
 	bzero(timestr, 20);
 	/*int year 	= (int)ldczn_time->year;
@@ -499,305 +1868,772 @@ int TcpServer::ProcessCalibrateTime(struct payload_req *req, char *buf)
 		(int)ldczn_time->day,
 		(int)ldczn_time->hour,
 		(int)ldczn_time->min,
-		(int)ldczn_time->sec
-		);
-	Util::CalibrateTime(timestr);
-	
-	struct packet_man_comp_time_ack packet;
-	char auth_code[sizeof(packet.ack.head)];
-	fill_std_header(&packet.ack.head, ENCODING_TYPE_RAW, 
-			auth_code, MESSAGE_TYPE_ACK, sizeof(packet));
-	packet.ack.ack.id	= 0;
-	packet.ack.ack.type	= req->type;
-	packet.ack.ack.status	= ACK_SUCCESS;
-	packet.time		= *ldczn_time;
-	SendToClient((char *)&packet, sizeof(packet));
-	
-	return 0;	
+		(int)ldczn_time->sec
+		);
+	Util::CalibrateTime(timestr);
+}
+
+/**
+ * @function	void PostCalibrateTime(const Ldczn_time *ldczn_time, struct payload_req *req)
+ * @brief	在工作线程中校时，完成后回复req(为NULL时不应答)并发送校时通知
+ *
+ */
+void TcpServer::PostCalibrateTime(const Ldczn_time *ldczn_time, struct payload_req *req)
+{
+	struct Work *work = WorkPool::Alloc(WORK_CLASS_SYSTEM, WORK_TIME, time_job);
+	memcpy(work->data, ldczn_time, sizeof(*ldczn_time));
+	if (req != NULL && _current != NULL) {
+		work->conn_id = _current->id;
+		work->req     = *req;
+	}
+	_workers.Post(work);
+}
+
+/* 参数事务各TLV的校验 */
+static unsigned int check_camera_param(const CameraParam *p)
+{
+	if (p->min_gain > p->max_gain || p->min_exposure > p->max_exposure)
+		return ACK_EXT_INVALID;
+	if (p->default_gain < p->min_gain || p->default_gain > p->max_gain)
+		return ACK_EXT_INVALID;
+	if (p->default_exposure < p->min_exposure ||
+	    p->default_exposure > p->max_exposure)
+		return ACK_EXT_INVALID;
+	return ACK_SUCCESS;
+}
+
+static unsigned int check_time(const Ldczn_time *t)
+{
+	if (t->year < 1970 || t->year > 2099 || t->mon < 1 || t->mon > 12 ||
+	    t->day < 1 || t->day > 31 || t->hour < 0 || t->hour > 23 ||
+	    t->min < 0 || t->min > 59 || t->sec < 0 || t->sec > 59)
+		return ACK_EXT_INVALID;
+	return ACK_SUCCESS;
 }
 
-int TcpServer::ProcessGetParameter(struct payload_req *req)
+/**
+ * @function	int ProcessSetAllParam(struct payload_req *req, char *buf)
+ * @brief	参数事务: 先校验全部TLV，任一项失败则都不生效；全部通过后在同一批
+ *		日志中保存，传感器只下发一次，最后校时。应答携带每项的状态
+ *
+ */
+int TcpServer::ProcessSetAllParam(struct payload_req *req, char *buf)
 {
 	Debug();
-	switch (req->type & 0x00FF0000) {
-	case PARAM_TYPE_CAMERA:
-		ProcessGetCameraParameter(req);
-		break;
-	case PARAM_TYPE_NETWORK:
-		ProcessGetNetworkParameter(req);
-		break;
-	case PARAM_TYPE_UPLOAD:
-		ProcessGetUploadParam(req);
-		break;
-	case PARAM_TYPE_TIME:
-		break;
-	case PARAM_TYPE_FLASH:
-		ProcessGetFlashParam(req);
-		break;
-	case PARAM_TYPE_PLATE:
-		break;
-	case PARAM_TYPE_VIDEO_DETECT:
-		break;
-	case PARAM_TYPE_MANNUFACTURE:
-		break;
-	case PARAM_TYPE_DEVICE_INFO:
-		ProcessGetDeviceInfo(req);
-		break;
-	case PARAM_TYPE_TRAFFIC:
-		ProcessGetTrafficParam(req);
-		break;
-	default :
-		break;
-        }
-        return 0;
+	struct ParamValues values;
+	Ldczn_time ldczn_time;
+	bool has_time = false;
+	unsigned int present = 0;
+	unsigned int status = ACK_SUCCESS;
+
+	char out[sizeof(struct packet_ext_ack) +
+		 PARAM_TLV_MAX * sizeof(struct param_status)] __attribute__((aligned(4)));
+	struct packet_ext_ack *packet = (struct packet_ext_ack *)out;
+	struct param_status *result = (struct param_status *)(packet + 1);
+	int count = 0;
+
+	char *p = buf;
+	while (p < _payload_end) {
+		if (count == PARAM_TLV_MAX ||
+		    _payload_end - p < (int)sizeof(struct param_tlv)) {
+			status = ACK_EXT_BAD_LENGTH;
+			break;
+		}
+
+		struct param_tlv *tlv = (struct param_tlv *)p;
+		char *value = (char *)(tlv + 1);
+		if ((unsigned int)(_payload_end - value) < tlv->length) {
+			status = ACK_EXT_BAD_LENGTH;
+			break;
+		}
+		p = value + PARAM_TLV_ALIGN(tlv->length);
+
+		struct param_status *st = &result[count++];
+		st->type   = tlv->type;
+		st->status = ACK_SUCCESS;
+
+		if (tlv->type == PARAM_TLV_TYPE(PARAM_TYPE_TIME)) {
+			if (has_time || tlv->length != sizeof(Ldczn_time)) {
+				st->status = has_time ? ACK_EXT_INVALID : ACK_EXT_BAD_LENGTH;
+			} else {
+				memcpy(&ldczn_time, value, sizeof(ldczn_time));
+				st->status = check_time(&ldczn_time);
+				has_time = true;
+			}
+		} else {
+			int group = -1;
+			for (int i = 0; i < PARAM_GROUP_NUM; i++)
+				if (tlv->type == PARAM_TLV_TYPE(param_all_types[i]))
+					group = i;
+
+			if (group < 0 || group == PARAM_GROUP_TRAFFIC) {
+				//未知类型或只读的交通参数
+				st->status = ACK_EXT_UNSUPPORTED;
+			} else if (present & (1 << group)) {
+				st->status = ACK_EXT_INVALID;
+			} else if (tlv->length != ParamStore::GroupSize(group)) {
+				st->status = ACK_EXT_BAD_LENGTH;
+			} else {
+				memcpy(ParamStore::Field(&values, group), value, tlv->length);
+				present |= 1 << group;
+				if (group == PARAM_GROUP_CAMERA)
+					st->status = check_camera_param(&values.camera);
+			}
+		}
+
+		if (st->status != ACK_SUCCESS)
+			status = ACK_EXT_FAILED;
+	}
+
+	if (status == ACK_SUCCESS && present == 0 && !has_time)
+		status = ACK_EXT_BAD_LENGTH;
+
+	//未能写入参数日志时整个事务失败
+	if (status == ACK_SUCCESS && present != 0 &&
+	    ParamStore::GetInstance()->SetAll(&values, present) < 0)
+		status = ACK_EXT_FAILED;
+
+	if (status != ACK_SUCCESS) {
+		Debug("set parameters rejected, status %#x", status);
+		for (int i = 0; i < count; i++)
+			if (result[i].status == ACK_SUCCESS)
+				result[i].status = ACK_EXT_NOT_APPLIED;
+	} else {
+		_sensor_host->_coalescer.ApplyNow(
+			(present & (1 << PARAM_GROUP_CAMERA)) != 0,
+			(present & (1 << PARAM_GROUP_FLASH)) != 0);
+
+		if (present & (1 << PARAM_GROUP_UPLOAD))
+			InitClient();
+
+		if (has_time)
+			PostCalibrateTime(&ldczn_time, NULL);
+
+		for (int group = 0; group < PARAM_GROUP_NUM; group++)
+			if (present & (1 << group))
+				NotifyParam(group);
+	}
+
+	unsigned int len = sizeof(*packet) + count * sizeof(struct param_status);
+	ack_fill(packet, len, req->id, req->type, status);
+
+	SendToClient(out, len);
+
+	return 0;
 }
 
 int TcpServer::ReturnAck(struct payload_req *req)
 {
 	struct packet_img_gparm_ack packet;
-	char	auth_code[sizeof(packet.ack.head)];
-	fill_std_header(&packet.ack.head, ENCODING_TYPE_RAW, auth_code,
-			MESSAGE_TYPE_ACK, sizeof(packet));
-
-	packet.ack.ack.id	= req->id;
-	packet.ack.ack.type	= req->type;
-	packet.ack.ack.status	= ACK_SUCCESS;
+	ack_fill(&packet, req->id, req->type, ACK_SUCCESS);
 
 	SendToClient((char *)&packet, sizeof(packet));
 	return 0;
 }
 
-int TcpServer::ProcessGetCameraParameter(struct payload_req *req)
+/* 只带状态的应答，用于请求本身不合法时 */
+int TcpServer::ReturnStatus(struct payload_req *req, unsigned int status)
 {
-	Debug();
-	CameraParam params = Parameters::GetInstance()->GetCameraParam();
+	struct packet_ack packet;
+	ack_fill(&packet, req->id, req->type, status);
 
-	struct packet_img_gparm_ack packet;
-	char	auth_code[sizeof(packet.ack.head)];
-	fill_std_header(&packet.ack.head, ENCODING_TYPE_RAW, auth_code,
-			MESSAGE_TYPE_ACK, sizeof(packet));
-
-	packet.ack.ack.id	= 0;
-	packet.ack.ack.type	= req->type;
-	packet.ack.ack.status	= ACK_SUCCESS;
-
-	packet.parameter.default_exposure	= params.default_exposure;
-	packet.parameter.min_exposure		= params.min_exposure;
-	packet.parameter.max_exposure		= params.max_exposure;
-	packet.parameter.default_gain		= params.default_gain;
-	packet.parameter.min_gain		= params.min_gain;
-	packet.parameter.max_gain		= params.max_gain;
-	packet.parameter.red_gain		= params.red_gain;
-	packet.parameter.blue_gain		= params.blue_gain;
-	packet.parameter.video_target_gray	= params.video_target_gray;
-	packet.parameter.trigger_target_gray	= params.trigger_target_gray;
-	packet.parameter.ae_zone 		= params.ae_zone;
-	packet.parameter.aew_mode		= params.aew_mode;
+	return SendToClient((char *)&packet, sizeof(packet));
+}
 
-	SendToClient((char *)&packet, sizeof(packet));
+/**
+ * @function	int ReturnCachedAck(struct payload_req *req, int group)
+ * @brief	用缓存的应答包回复参数查询，只修改包头中的ack.type
+ *
+ */
+int TcpServer::ReturnCachedAck(struct payload_req *req, int group)
+{
+	unsigned int gen;
+	struct TxBuffer *buf = _ack_cache.Lookup(group, &gen);
+	if (buf == NULL)
+		return -1;
+
+	if (ReturnNotModified(req, gen))
+		return 0;
+
+	struct packet_ack head = *(struct packet_ack *)buf->data;
+	head.ack.type	= req->type;
+
+	SendShared((char *)&head, sizeof(head), buf, sizeof(head),
+		   buf->len - sizeof(head));
 
 	return 0;
 }
 
-int TcpServer::ProcessGetDeviceInfo(struct payload_req *req)
+/**
+ * @function	bool ReturnNotModified(struct payload_req *req, unsigned int gen)
+ * @brief	条件查询且客户端的修改计数与当前相同时回复未修改
+ * @return	true已回复，false需回复完整参数
+ */
+bool TcpServer::ReturnNotModified(struct payload_req *req, unsigned int gen)
 {
-	Debug();
-	DeviceInfo params = Parameters::GetInstance()->GetDeviceInfo();
+	if (!(req->type & PARAM_GET_CONDITIONAL) || req->id != gen)
+		return false;
+
+	struct packet_ack packet;
+	ack_fill(&packet, gen, req->type, ACK_EXT_NOT_MODIFIED);
 
-	struct packet_deviceinfo_gparam_ack packet;
-	char	auth_code[sizeof(packet.ack.head)];
-	fill_std_header(&packet.ack.head, ENCODING_TYPE_RAW, auth_code,
-			MESSAGE_TYPE_ACK, sizeof(packet));
+	SendToClient((char *)&packet, sizeof(packet));
+	return true;
+}
 
-	packet.ack.ack.id	= 0;
-	packet.ack.ack.type	= req->type;
-	packet.ack.ack.status	= ACK_SUCCESS;
+/**
+ * @function	int ProcessGetAllParam(struct payload_req *req, char *data)
+ * @brief	一次应答返回全部参数组，各组取自同一时刻的参数
+ *
+ */
+int TcpServer::ProcessGetAllParam(struct payload_req *req, char *data)
+{
+	Debug();
+	data = data;
+
+	if (ReturnNotModified(req, ParamStore::GetInstance()->GenerationAll()))
+		return 0;
+
+	//参数和应答包放在连接的临时内存中，只在本帧处理期间有效，
+	//SendToClient拷贝到发送缓冲后即可复位
+	const unsigned int max_len = sizeof(struct packet_ext_ack) + sizeof(struct ParamValues) +
+				     PARAM_GROUP_NUM * (sizeof(struct param_tlv) + 3);
+	struct ParamValues *values = NULL;
+	char *buf = NULL;
+	if (_current != NULL) {
+		values = (struct ParamValues *)_current->Scratch(sizeof(*values));
+		buf = (char *)_current->Scratch(max_len);
+	}
+	if (values == NULL || buf == NULL)
+		return ReturnStatus(req, ACK_EXT_BUSY);
+
+	unsigned int gen;
+	ParamStore::GetInstance()->GetAll(values, &gen);
+
+	struct packet_ext_ack *packet = (struct packet_ext_ack *)buf;
+	unsigned int len = sizeof(*packet);
+
+	for (int group = 0; group < PARAM_GROUP_NUM; group++) {
+		unsigned int size = ParamStore::GroupSize(group);
+		struct param_tlv *tlv = (struct param_tlv *)(buf + len);
+		tlv->type   = PARAM_TLV_TYPE(param_all_types[group]);
+		tlv->length = size;
+		memcpy(tlv + 1, ParamStore::Field(values, group), size);
+		memset((char *)(tlv + 1) + size, 0, PARAM_TLV_ALIGN(size) - size);
+		len += sizeof(*tlv) + PARAM_TLV_ALIGN(size);
+	}
 
-	memcpy(&packet.info, &params, sizeof(DeviceInfo));
+	ack_fill(packet, len, gen, req->type, ACK_SUCCESS);
 
-	SendToClient((char *)&packet, sizeof(packet));
+	SendToClient(buf, len);
 
 	return 0;
 }
 
-int TcpServer::ProcessGetNetworkParameter(struct payload_req *req)
+/**
+ * @function	int ProcessGetMetrics(struct payload_req *req, char *buf)
+ * @brief	回复各内存池的占用，连接池为本reactor分片的
+ *
+ */
+int TcpServer::ProcessGetMetrics(struct payload_req *req, char *buf)
 {
 	Debug();
-	NetworkParam params = Parameters::GetInstance()->GetNetworkParam();
+	buf = buf;
 
-	struct packet_networparam_gparam_ack packet;
-	char	auth_code[sizeof(packet.ack.head)];
-	fill_std_header(&packet.ack.head, ENCODING_TYPE_RAW, auth_code,
-			MESSAGE_TYPE_ACK, sizeof(packet));
+	struct SlabStat stat[POOL_METRIC_NUM];
+	_conn_slab.GetStat(&stat[POOL_METRIC_CONN]);
+	tx_buffer_stat(&stat[POOL_METRIC_TX_BUFFER]);
+	WorkPool::Stat(&stat[POOL_METRIC_WORK]);
+
+	struct packet_pool_metrics_ack packet;
+	for (int i = 0; i < POOL_METRIC_NUM; i++) {
+		packet.pool[i].size	= stat[i].size;
+		packet.pool[i].total	= stat[i].total;
+		packet.pool[i].in_use	= stat[i].in_use;
+		packet.pool[i].peak	= stat[i].peak;
+		packet.pool[i].fails	= stat[i].fails;
+	}
+	ack_fill(&packet, req->id, req->type, ACK_SUCCESS);
 
-	packet.ack.ack.id	= 0;
-	packet.ack.ack.type	= req->type;
-	packet.ack.ack.status	= ACK_SUCCESS;
+	return SendToClient((char *)&packet, sizeof(packet));
+}
 
-	memcpy(&packet.parameter, &params, sizeof(NetworkParam));
+/**
+ * @function	int ProcessUpgradeApp(struct payload_req *req, char *buf)
+ * @brief	开始接收升级文件，之后的total_length字节由reactor流式写入
+ *		/data/<file_name>，收满后应答；请求附带CRC32C时核对后才安装
+ *
+ */
+int TcpServer::ProcessUpgradeApp(struct payload_req *req, char *buf)
+{
+	Debug();
 
-	SendToClient((char *)&packet, sizeof(packet));
+	payload_man_upgrade copy;
+	const payload_man_upgrade *upd_camera = payload_view(buf, _payload_end, &copy);
+	if (upd_camera == NULL)
+		return -1;
+	char file_name[sizeof(upd_camera->file_name) + 1];
+	memcpy(file_name, upd_camera->file_name, sizeof(upd_camera->file_name));
+	file_name[sizeof(upd_camera->file_name)] = '\0';
 
-	return 0;
+	if (_current == NULL || _current->upgrade != NULL) {
+		return -1;
+	}
+
+	//Begin失败时接收对象丢弃文件数据，收完后回失败应答
+	UpgradeReceiver *receiver = new UpgradeReceiver(req->type);
+	receiver->SetPool(&_workers, _current->id);
+	if (_ring_enabled)
+		receiver->EnableIoUring();
+	if ((unsigned int)(_payload_end - buf) >= sizeof(struct payload_upgrade_stream)) {
+		payload_upgrade_stream stream;
+		receiver->Expect(payload_view(buf, _payload_end, &stream)->crc32c);
+	}
+	int ret = receiver->Begin(file_name, upd_camera->total_length);
+	_current->upgrade = receiver;
+	StartExchange(_current, EXCHANGE_UPGRADE, req);
+	return ret;
 }
 
-int TcpServer::ProcessGetUploadParam(struct payload_req *req)
+/**
+ * @function	int ProcessUpgradeResume(struct payload_req *req, char *buf)
+ * @brief	开始或续接分块传输，应答已落盘的字节数作为续传起点
+ *
+ */
+int TcpServer::ProcessUpgradeResume(struct payload_req *req, char *buf)
 {
-	Debug();
-	UploadParam params = Parameters::GetInstance()->GetUploadParam();
-
-	struct packet_uploadinfo_gparam_ack packet;
-	char	auth_code[sizeof(packet.ack.head)];
-	fill_std_header(&packet.ack.head, ENCODING_TYPE_RAW, auth_code,
-			MESSAGE_TYPE_ACK, sizeof(packet));
+	payload_man_upgrade copy;
+	const payload_man_upgrade *upd_camera = payload_view(buf, _payload_end, &copy);
+	if (upd_camera == NULL)
+		return -1;
+	char file_name[sizeof(upd_camera->file_name) + 1];
+	memcpy(file_name, upd_camera->file_name, sizeof(upd_camera->file_name));
+	file_name[sizeof(upd_camera->file_name)] = '\0';
 
-	packet.ack.ack.id	= 0;
-	packet.ack.ack.type	= req->type;
-	packet.ack.ack.status	= ACK_SUCCESS;
+	if (_current == NULL || _current->Streaming()) {
+		return -1;
+	}
 
-	memcpy(&packet.parameter, &params, sizeof(UploadParam));
+	UpgradeReceiver *receiver = _current->upgrade;
+	if (receiver != NULL && !receiver->Matches(file_name, upd_camera->total_length)) {
+		DropUpgrade(_current);
+		receiver = NULL;
+	}
 
-	SendToClient((char *)&packet, sizeof(packet));
+	if (receiver != NULL) {
+		//落盘后在交互中回复进度
+		WaitWork(req, WORK_UPGRADE_SYNC);
+		receiver->PostSync(req);
+		return 0;
+	}
 
+	receiver = new UpgradeReceiver(req->type);
+	receiver->SetPool(&_workers, _current->id);
+	if (_ring_enabled)
+		receiver->EnableIoUring();
+	if (receiver->Resume(req, file_name, upd_camera->total_length) < 0) {
+		ReturnUpgradeProgress(req, ACK_EXT_FAILED, receiver);
+		delete receiver;
+		return -1;
+	}
+	//打开文件、回读已落盘部分在存储工作线程中执行，完成后在交互中回复进度
+	_current->upgrade = receiver;
+	WaitWork(req, WORK_UPGRADE_OPEN);
 	return 0;
 }
 
+/**
+ * @function	int ProcessUpgradeChunk(struct payload_req *req, char *buf)
+ * @brief	写入一个数据块，每落盘UPGRADE_SYNC_BYTES回一次进度；
+ *		偏移不连续时回ACK_EXT_BAD_OFFSET，客户端从应答中的位置重传
+ *
+ */
+int TcpServer::ProcessUpgradeChunk(struct payload_req *req, char *buf)
+{
+	struct payload_upgrade_chunk copy;
+	const struct payload_upgrade_chunk *chunk = payload_view(buf, _payload_end, &copy);
+	if (chunk == NULL)
+		return -1;
+	char *data = buf + sizeof(*chunk);
+
+	UpgradeReceiver *receiver = _current != NULL ? _current->upgrade : NULL;
+	if (receiver == NULL || receiver->Streaming()) {
+		return -1;
+	}
+
+	if (chunk->length > (unsigned int)(_payload_end - data) ||
+	    chunk->length > UPGRADE_CHUNK_MAX) {
+		ReturnUpgradeProgress(req, ACK_EXT_BAD_LENGTH, receiver);
+		return -1;
+	}
+
+	int ret = receiver->WriteChunk(chunk->offset, data, chunk->length);
+	if (ret == -1) {
+		ReturnUpgradeProgress(req, ACK_EXT_BAD_OFFSET, receiver);
+		return -1;
+	} else if (ret < 0) {
+		ReturnUpgradeProgress(req, ACK_EXT_FAILED, receiver);
+		return -1;
+	}
+
+	//进度应答排在后续请求的应答之前，落盘完成前不处理后续请求
+	if (receiver->SyncDue() || receiver->Done()) {
+		WaitWork(req, WORK_UPGRADE_SYNC);
+		receiver->PostSync(req);
+	}
+	return 0;
+}
 
-int TcpServer::ProcessGetTrafficParam(struct payload_req *req)
+/**
+ * @function	int ProcessUpgradeCommit(struct payload_req *req, char *buf)
+ * @brief	分块传输完成，校验长度后安装文件
+ *
+ */
+int TcpServer::ProcessUpgradeCommit(struct payload_req *req, char *buf)
 {
-	Debug();
-	TrafficParam params = Parameters::GetInstance()->GetTrafficParam();
+	struct payload_upgrade_commit copy;
+	const struct payload_upgrade_commit *commit = payload_view(buf, _payload_end, &copy);
+	if (commit == NULL)
+		return -1;
 
-	struct packet_deviceinfo_gparam_ack packet;
-	char	auth_code[sizeof(packet.ack.head)];
-	fill_std_header(&packet.ack.head, ENCODING_TYPE_RAW, auth_code,
-			MESSAGE_TYPE_ACK, sizeof(packet));
+	UpgradeReceiver *receiver = _current != NULL ? _current->upgrade : NULL;
+	if (receiver == NULL || receiver->Streaming()) {
+		return -1;
+	}
+
+	if (commit->total_length != receiver->Total() || !receiver->Done()) {
+		ReturnUpgradeProgress(req, ACK_EXT_BAD_LENGTH, receiver);
+		return -1;
+	}
 
-	packet.ack.ack.id	= 0;
-	packet.ack.ack.type	= req->type;
-	packet.ack.ack.status	= ACK_SUCCESS;
+	//排在未完成的落盘之后执行，安装完成后在交互中应答
+	_current->upgrade = NULL;
+	WaitWork(req, WORK_UPGRADE_FINISH);
+	receiver->PostFinish(req, true, commit->crc32c);
 
-	memcpy(&packet.info, &params, sizeof(TrafficParam));
+	return 0;
+}
 
+int TcpServer::ReturnUpgradeAck(unsigned int req_type, unsigned int status,
+				UpgradeReceiver *receiver)
+{
+	struct packet_man_upgrade_stat_ack packet;
+	ack_fill(&packet, 0, req_type, status);
+	packet.stat.received		= receiver->Received();
+	packet.stat.elapsed_ms		= receiver->ElapsedMs();
+	packet.stat.throughput		= receiver->Throughput();
+	packet.stat.crc32c		= receiver->Crc();
 	SendToClient((char *)&packet, sizeof(packet));
 
 	return 0;
 }
 
-int TcpServer::ProcessGetFlashParam(struct payload_req *req)
+int TcpServer::ReturnUpgradeProgress(struct payload_req *req, unsigned int status,
+				     UpgradeReceiver *receiver)
 {
-	Debug();
-	FlashParam params = Parameters::GetInstance()->GetFlashParam();
+	struct packet_man_upgrade_progress_ack packet;
+	ack_fill(&packet, req->id, req->type, status);
+	packet.progress.total_length	= receiver->Total();
+	//偏移错误时返回期望的下一块偏移，其余返回已落盘字节数
+	packet.progress.durable		= status == ACK_EXT_BAD_OFFSET ?
+					  receiver->Received() : receiver->Durable();
+	packet.progress.chunk_size	= UPGRADE_CHUNK_MAX;
+	packet.progress.window		= UPGRADE_WINDOW;
+	packet.progress.crc32c		= receiver->Crc();
+	SendToClient((char *)&packet, sizeof(packet));
 
-	struct packet_flash_gparam_ack packet;
-	char	auth_code[sizeof(packet.ack.head)];
-	fill_std_header(&packet.ack.head, ENCODING_TYPE_RAW, auth_code,
-			MESSAGE_TYPE_ACK, sizeof(packet));
+	return 0;
+}
 
-	packet.ack.ack.id	= 0;
-	packet.ack.ack.type	= req->type;
-	packet.ack.ack.status	= ACK_SUCCESS;
+/**
+ * @function	int ProcessSubscribe(struct payload_req *req, char *buf)
+ * @brief	设置当前连接订阅的通知事件，events为0时取消订阅
+ *
+ */
+int TcpServer::ProcessSubscribe(struct payload_req *req, char *buf)
+{
+	Debug();
+	struct payload_subscribe copy;
+	const struct payload_subscribe *sub = payload_view(buf, _payload_end, &copy);
+	unsigned int status = ACK_SUCCESS;
+	if (_current == NULL) {
+		status = ACK_EXT_FAILED;
+	} else if (sub == NULL) {
+		status = ACK_EXT_BAD_LENGTH;
+	} else {
+		_current->notify_mask = sub->events;
+	}
 
-	memcpy(&packet.parameter, &params, sizeof(FlashParam));
+	struct packet_ack packet;
+	ack_fill(&packet, req->id, req->type, status);
 
 	SendToClient((char *)&packet, sizeof(packet));
 
 	return 0;
 }
 
-int TcpServer::ProcessMannufacture(struct payload_req *req, char *buf)
+/**
+ * @function	void Notify(unsigned int event, unsigned int gen, const void *data,
+ *			    unsigned int len)
+ * @brief	通知消息只生成一次，放入共享发送缓冲后由各订阅连接的输出队列引用；
+ *		本批设置落盘后由FlushNotified发出
+ *
+ */
+void TcpServer::Notify(unsigned int event, unsigned int gen, const void *data,
+		       unsigned int len)
 {
-	Debug();
-	switch(req->type & 0X00FF0000) {
-	case REQ_MAN_FMT:
-		break;
-	case REQ_MAN_UPG:
-		return ProcessUpgrade(req, buf);
-		break;
-	case REQ_MAN_RESET:
-		break;
-	case REQ_MAN_CLR:
-		break;
-	default:
-		break;
+	TcpConnection *conn;
+	for (conn = _conns; conn != NULL; conn = conn->next)
+		if (conn->notify_mask & event)
+			break;
+	if (conn == NULL)
+		return;
+
+	unsigned int size = sizeof(struct header_std) + sizeof(struct payload_notify) + len;
+	struct TxBuffer *buf = tx_buffer_alloc(size);
+	if (buf == NULL)
+		return;
+
+	struct header_std *head = (struct header_std *)buf->data;
+	char	auth_code[sizeof(*head)];
+	fill_std_header(head, ENCODING_TYPE_RAW, auth_code, MESSAGE_TYPE_NOTIFY, size);
+
+	struct payload_notify *notify = (struct payload_notify *)(head + 1);
+	notify->event	= event;
+	notify->gen	= gen;
+	notify->length	= len;
+	memcpy(notify + 1, data, len);
+	buf->len = size;
+
+	for (; conn != NULL; conn = conn->next) {
+		if (!(conn->notify_mask & event))
+			continue;
+		//积压的连接丢弃通知，避免慢订阅者占用内存
+		if (conn->TxBlocked() || conn->Enqueue(buf, 0, size) < 0) {
+			Debug("drop notify %#x on fd %d", event, conn->Fd());
+			continue;
+		}
+		if (conn != _current)
+			_notify_pending = true;
 	}
 
-	return -1;
+	tx_buffer_put(buf);
 }
 
-int TcpServer::ProcessUpgrade(struct payload_req *req, char *buf)
+/**
+ * @function	void NotifyParam(int group)
+ * @brief	向本reactor的订阅连接发送参数组变化通知，并转发给其他分片
+ *
+ */
+void TcpServer::NotifyParam(int group)
 {
-	Debug();
+	NotifyGroup(group);
+	Forward(NOTIFY_EVENT_PARAM(group), NULL, 0);
+}
 
-	switch(req->type & 0X000000FF) {
+void TcpServer::NotifyGroup(int group)
+{
+	struct ParamValues values;
+	unsigned int gen;
+	void *data = ParamStore::Field(&values, group);
+	if (data == NULL || ParamStore::GetInstance()->Get(group, data, &gen) < 0)
+		return;
 
-	case REQ_MAN_UPG_BACK:
-		break;
-	case REQ_MAN_UPG_APP:
-		return ProcessUpgradeApp(req, buf);
-		break;
-	case REQ_MAN_UPG_PREF:
-		break;
-	case REQ_MAN_UPG_DRV:
-		break;
-	case REQ_MAN_UPG_ALG_MOD:
-		break;
-	case REQ_MAN_UPG_LIB:
-		break;
-	case REQ_MAN_UPG_ALG:
-		break;
-	case REQ_MAN_UPG_MON:
-		break;
-	case REQ_MAN_UPG_MCU:
-		break;
-	case REQ_MAN_UPG_FPGA:
-		break;
-	default:
-		break;
+	Notify(NOTIFY_EVENT_PARAM(group), gen, data, ParamStore::GroupSize(group));
+}
+
+/**
+ * @function	void Forward(unsigned int event, const void *data, unsigned int len)
+ * @brief	把变化通知放入其他分片的完成队列，由其reactor线程发给自己的订阅连接
+ *
+ */
+void TcpServer::Forward(unsigned int event, const void *data, unsigned int len)
+{
+	TcpServer *primary = _primary != NULL ? _primary : this;
+	if (len > WORK_DATA_SIZE)
+		return;
+
+	for (int i = 0; i < primary->_shard_count; i++) {
+		TcpServer *shard = primary->_shards[i];
+		if (shard == NULL || shard == this)
+			continue;
+
+		struct Work *work = WorkPool::Alloc(WORK_CLASS_SYSTEM, WORK_NOTIFY, NULL);
+		work->value = event;
+		work->len   = len;
+		if (len > 0)
+			memcpy(work->data, data, len);
+		shard->_workers.Done(work);
 	}
-	
-	return -1;
 }
 
-int TcpServer::ProcessUpgradeApp(struct payload_req *req, char *buf)
+/**
+ * @function	void FlushNotified()
+ * @brief	发送各订阅连接输出队列中的通知，写不完的部分等待各自的EPOLLOUT，
+ *		发送出错的连接关闭
+ *
+ */
+void TcpServer::FlushNotified()
 {
-	Debug();
-	
-	payload_man_upgrade *upd_camera = (payload_man_upgrade *)buf;
-	int file_length = upd_camera->total_length;
-	char *file_name = upd_camera->file_name;
-
-	char directory[512] = "/data/";
-	file_name = strcat(directory, file_name);
-	FILE *fp = fopen(file_name, "w");
-	char buffer[RECV_BUF_LENGTH];
-	int rec_length = 0;
-	while (1) {
-		bzero(buffer, RECV_BUF_LENGTH);
-		int ret = Socket::Read(clnt_sock, buffer, RECV_BUF_LENGTH, 5000);
-		if (ret > 0) {
-			int nwrite = fwrite(buf, sizeof(char), ret, fp);
-			if (nwrite < ret)
-				Debug("Write data to file failed");
-			rec_length += ret;
-		}
-		else if(ret == -1) {
-			Debug("read sock failed");
-		}
-		if (rec_length < file_length)
+	_notify_pending = false;
+	if (FlushBatched())
+		return;
+
+	TcpConnection *next;
+	for (TcpConnection *conn = _conns; conn != NULL; conn = next) {
+		next = conn->next;
+		if (!conn->TxPending())
 			continue;
-		fclose(fp);
-		break;
+		if (conn->Flush() < 0)
+			CloseClient(conn);
+		else
+			WatchWrite(conn);
 	}
+}
 
-	struct packet_man_upgrade_ack packet;
-	char auth_code[sizeof(packet.ack.head)];
-	fill_std_header(&packet.ack.head, ENCODING_TYPE_RAW, 
-			auth_code, MESSAGE_TYPE_ACK, sizeof(packet));
-	packet.ack.ack.id	= 0;
-	packet.ack.ack.type	= req->type;
-	packet.ack.ack.status	= ACK_SUCCESS;
-	SendToClient((char *)&packet, sizeof(packet));
+/**
+ * @function	void WatchWrite(TcpConnection *conn)
+ * @brief	输出队列有未发完的数据时开始写超时计时，排空后取消
+ *
+ */
+void TcpServer::WatchWrite(TcpConnection *conn)
+{
+	if (!conn->TxPending()) {
+		_timers.Del(&conn->write_timer);
+		return;
+	}
 
-	return 0;
+	if (!timer_pending(&conn->write_timer)) {
+		conn->tx_mark = conn->TxSent();
+		_timers.Add(&conn->write_timer, TimerWheel::Ticks() +
+			    TimerWheel::MsToTicks(CONN_WRITE_TIMEOUT_MS));
+	}
+}
+
+/**
+ * @function	void ExpireTimers()
+ * @brief	处理到期的连接定时器: 到期时才按最后收到数据的时间和已发送字节数
+ *		判断是否真正超时，仍有活动的重新加入时间轮
+ *
+ */
+void TcpServer::ExpireTimers()
+{
+	_timers.Expire();
+
+	unsigned long long now = TimerWheel::Ticks();
+	struct Timer *timer;
+	while ((timer = _timers.Next()) != NULL) {
+		TcpConnection *conn = (TcpConnection *)timer->arg;
+
+		if (timer->type == CONN_TIMER_IDLE) {
+			unsigned int ms = conn->heartbeat ? CONN_HEARTBEAT_TIMEOUT_MS :
+							    CONN_IDLE_TIMEOUT_MS;
+			unsigned long long deadline = conn->last_rx +
+						      TimerWheel::MsToTicks(ms);
+			if (deadline > now) {
+				_timers.Add(timer, deadline);
+				continue;
+			}
+			Debug("client %u %s timeout", conn->id,
+			      conn->heartbeat ? "heartbeat" : "idle");
+			CloseClient(conn);
+		} else if (timer->type == CONN_TIMER_EXCHANGE) {
+			conn->exchange.expired = true;
+			HandleClient(conn, 0);
+		} else {
+			if (!conn->TxPending())
+				continue;
+			if (conn->TxSent() != conn->tx_mark) {
+				conn->tx_mark = conn->TxSent();
+				_timers.Add(timer, now +
+					    TimerWheel::MsToTicks(CONN_WRITE_TIMEOUT_MS));
+				continue;
+			}
+			Debug("client %u write timeout", conn->id);
+			CloseClient(conn);
+		}
+	}
+}
+
+/**
+ * @function	void CompleteWork()
+ * @brief	处理工作线程执行完的任务: 向发起请求的连接发送应答和变化通知，
+ *		连接已断开时只释放资源
+ *
+ */
+void TcpServer::CompleteWork()
+{
+	struct Work *work = _workers.Complete();
+	while (work != NULL) {
+		struct Work *next = work->next;
+		UpgradeReceiver *receiver = (UpgradeReceiver *)work->arg;
+
+		switch (work->type) {
+		case WORK_MODE:
+			DeliverWork(work);
+			Notify(NOTIFY_EVENT_MODE, 0, &work->value, sizeof(work->value));
+			Forward(NOTIFY_EVENT_MODE, &work->value, sizeof(work->value));
+			break;
+		case WORK_REBOOT:
+			DeliverWork(work);
+			break;
+		case WORK_TIME:
+			//由等待的校时交互应答，参数事务中的校时和已超时的不应答
+			DeliverWork(work);
+			Notify(NOTIFY_EVENT_TIME, 0, work->data, sizeof(Ldczn_time));
+			Forward(NOTIFY_EVENT_TIME, work->data, sizeof(Ldczn_time));
+			break;
+		case WORK_NOTIFY:
+			//参数组从ParamStore重新读取，数据和修改计数是最新的
+			if (work->value & (NOTIFY_EVENT_MODE | NOTIFY_EVENT_TIME)) {
+				Notify(work->value, 0, work->data, work->len);
+			} else {
+				for (int group = 0; group < PARAM_GROUP_NUM; group++)
+					if (work->value & NOTIFY_EVENT_PARAM(group))
+						NotifyGroup(group);
+			}
+			break;
+		case WORK_UPGRADE_OPEN:
+		case WORK_UPGRADE_WRITE:
+			receiver->JobDone(work);
+			if (receiver->Orphaned()) {
+				if (!receiver->Busy())
+					delete receiver;
+			} else if (!receiver->Streaming()) {
+				//分块传输续接完成，由等待的交互回复进度；写盘不暂停分块传输
+				if (work->type == WORK_UPGRADE_OPEN)
+					DeliverWork(work);
+			} else {
+				//继续接收暂停的升级数据
+				TcpConnection *conn = FindClient(work->conn_id);
+				if (conn != NULL && conn->upgrade == receiver)
+					HandleClient(conn, 0);
+			}
+			break;
+		case WORK_UPGRADE_SYNC:
+			receiver->JobDone(work);
+			if (receiver->Orphaned()) {
+				if (!receiver->Busy())
+					delete receiver;
+			} else {
+				DeliverWork(work);
+			}
+			break;
+		case WORK_UPGRADE_FINISH:
+			receiver->JobDone(work);
+			DeliverWork(work);
+			delete receiver;
+			break;
+		default:
+			break;
+		}
+
+		_current = NULL;
+		clnt_sock = -1;
+		WorkPool::Free(work);
+		work = next;
+	}
+
+	if (_notify_pending)
+		FlushNotified();
 }
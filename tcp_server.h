@@ -22,11 +22,33 @@
 #ifndef _TCPSERVER_H_
 #define _TCPSERVER_H_
 
+#include <pthread.h>
 #include "thread.h"
 //#include "tcp_client.h"
 #include "ldczn_protocol.h"
+#include "sensor_shadow.h"
+#include "param_coalescer.h"
+#include "ack_cache.h"
+#include "udp_control.h"
+#include "work_pool.h"
+#include "timer_wheel.h"
+#include "io_ring.h"
+#include "request_table.h"
+#include "slab.h"
+
+//请求优先级分类，数值越小越优先
+#define REQ_CLASS_CONTROL	0	//控制、升级，不限流
+#define REQ_CLASS_SET		1
+#define REQ_CLASS_GET		2
+#define REQ_CLASS_HEARTBEAT	3
+#define REQ_CLASS_NUM		4
+
+#define MAX_REACTOR_SHARDS	16	//SO_REUSEPORT分片reactor的最大个数
 
 class TcpClient;
+class TcpConnection;
+struct TxBuffer;
+class UpgradeReceiver;
 class Uart;
 class Util;
 
@@ -39,50 +61,156 @@ public:
 	//TcpServer();
 	~TcpServer();
 
+	void Shutdown();
+	void Stop();
+	void SetCoalesceWindow(unsigned int ms);
+	void SetLowLatency(int rt_priority, int cpu, int busy_poll_us);
+	void EnableUdpControl(bool enable) { _udp_enabled = enable; }
+	void SetShards(int count);
+	void EnableIoUring(bool enable) { _ring_enabled = enable; }
+	int  RegisterRequest(const struct RequestHandler *handler) { return _requests.Register(handler); }
+
 protected:
 	void Run();
 
 
 private:
+	TcpServer(TcpServer *primary, int shard);
+
 	int  server_sock;	//服务器socket
-	int  clnt_sock;		//客户端socket
+	int  clnt_sock;		//当前处理请求的客户端socket
+	int  _epoll_fd;		//reactor epoll句柄
+	int  _wakeup_fd;	//退出通知eventfd
+	int  _idle_fd;		//fd耗尽时的备用句柄
+
+	TcpConnection *_conns;	//活动连接链表
+	TcpConnection *_closed;	//本轮事件处理后释放的连接
+	unsigned int _next_conn_id;
+	TcpConnection *_current;//当前处理请求的连接
+	char *_payload_end;	//当前请求帧的结束位置
+	bool _notify_pending;	//有通知或异步应答待发送到其他连接
+	int  _round_waiting;	//本轮epoll事件中还在等待处理的连接数
+	unsigned int _admitted[REQ_CLASS_NUM];	//本轮各类请求已处理数
+
+	int  _rt_priority;	//reactor线程SCHED_FIFO优先级，0为普通调度
+	int  _rt_cpu;		//reactor线程绑定的CPU，-1不绑定
+	int  _busy_poll_us;	//客户端socket的SO_BUSY_POLL，0不启用
 	
 	TcpClient *_tcp_client;	//相机客户端线程对象指针
+	SensorShadow _sensor_shadow;	//已下发到传感器的相机参数，由传感器工作线程加锁访问
+	SensorShadow *_shadow;		//各分片共用主reactor的_sensor_shadow
+	WorkPool _workers;		//耗时操作的工作线程
+	ParamCoalescer _coalescer;	//相机/闪光灯参数合并下发，只使用主reactor的
+	TcpServer *_sensor_host;	//主reactor，其合并器和传感器工作线程为各分片共用，
+					//参数下发和模式切换按提交顺序执行
+	AckCache _ack_cache;		//参数查询应答缓存
+	UdpControl _udp;		//心跳/抓拍UDP通道
+	TimerWheel _timers;		//连接空闲/心跳/写超时
+	IoRing _ring;			//multishot accept和批量发送，不可用时为epoll方式
+	bool _ring_enabled;
+	bool _ring_accept;		//新连接由io_uring accept产生
+	int  _ring_sends;		//已提交未完成的发送
+	bool _udp_enabled;
+	RequestTable _requests;		//请求分发表及各类型计数
+	Slab _conn_slab;		//连接对象池，仅本reactor使用
+
+	static const struct RequestHandler _request_handlers[];
+
+	//分片: 主reactor(_primary为NULL)在Init中创建其余分片，各分片有独立的
+	//监听socket、epoll、连接、定时器和工作线程，参数变化通知经对方的完成队列转发
+	TcpServer *_primary;
+	int  _shard;
+	int  _shard_count;
+	TcpServer *_shards[MAX_REACTOR_SHARDS];	//[0]为主reactor
+	pthread_t _thread;			//分片线程，由主reactor join
+	bool _joinable;
 	//Uart *_signal_module;
 
-	void Init();
+	void InitState();
+	int  Init();
+	int  StartShards();
+	void StopShards();
+	static void *ShardMain(void *arg);
 	void InitClient();
+	void Release();
+
+	void AcceptClients();
+	void AddClient(int sock);
+	bool ArmAccept();
+	void FallbackAccept();
+	void AcceptRing(int res, bool more);
+	void ReapRing();
+	bool FlushBatched();
+	void DisableRing();
+	void HandleClient(TcpConnection *conn, unsigned int events);
+	void CloseClient(TcpConnection *conn);
+	void ReapClients();
+	void FreeClient(TcpConnection *conn);
+	TcpConnection *FindClient(unsigned int id);
+	bool SelectClient(unsigned int id);
+	void DropUpgrade(TcpConnection *conn);
+	void CompleteWork();
+	void ExpireTimers();
+	void WatchWrite(TcpConnection *conn);
+	int  ProcessFrames(TcpConnection *conn);
+	void FireSnaps(TcpConnection *conn);
+	bool Admit(char *frame);
+	void HandleUdp();
+	void ApplyRealtime();
+	void StartExchange(TcpConnection *conn, int type, const struct payload_req *req);
+	int  RunExchange(TcpConnection *conn);
+	void ExpectWithin(TcpConnection *conn, unsigned int ms);
+	int  UpgradeExchange(TcpConnection *conn, struct Exchange *ex);
+	int  TimeExchange(TcpConnection *conn, struct Exchange *ex);
+	int  WorkExchange(TcpConnection *conn, struct Exchange *ex);
+	void WaitWork(struct payload_req *req, int work_type);
+	bool DeliverWork(struct Work *work);
+	void ReplyWork(struct Work *work);
 
 	int ParsePacket(char *buf, int len);
 	int ProcessHeartBeat(struct payload_req *req, char *buf);
 	int ProcessRequest(struct payload_req *req, char *buf);
 	int ProcessAck(struct payload_ack *ack, char *buf);
 	int ProcessHeader(struct header_std *head, int packet_len);
-	int ProcessMannufacture(struct payload_req *req, char *buf);
-	int ProcessUpgrade(struct payload_req *req, char *buf);
 	int ProcessUpgradeApp(struct payload_req *req, char *buf);
+	int ProcessUpgradeResume(struct payload_req *req, char *buf);
+	int ProcessUpgradeChunk(struct payload_req *req, char *buf);
+	int ProcessUpgradeCommit(struct payload_req *req, char *buf);
+	int ReturnUpgradeAck(unsigned int req_type, unsigned int status,
+			     UpgradeReceiver *receiver);
+	int ReturnUpgradeProgress(struct payload_req *req, unsigned int status,
+				  UpgradeReceiver *receiver);
 
-	int ProcessSetParameter(struct payload_req *req, char *buf);
 	//int ProcessSetCameraParameter(char *buf);
 	int ProcessSetCameraParameter(struct payload_req *req, char *buf);
-	int ProcessSetNetworkParam(char *buf);
-	int ProcessSetUploadParam(char *buf);
-	int ProcessSetDeviceInfo(char *buf);
-	int ProcessSetFlashParam(char *buf);
+	int ProcessSetNetworkParam(struct payload_req *req, char *buf);
+	int ProcessSetUploadParam(struct payload_req *req, char *buf);
+	int ProcessSetDeviceInfo(struct payload_req *req, char *buf);
+	int ProcessSetFlashParam(struct payload_req *req, char *buf);
 	int ProcessCalibrateTime(struct payload_req *req, char *buf);
-
-	int ProcessGetParameter(struct payload_req *req);
-	int ProcessGetCameraParameter(struct payload_req *req);
-	int ProcessGetDeviceInfo(struct payload_req *req);
-	int ProcessGetNetworkParameter(struct payload_req *req);
-	int ProcessGetUploadParam(struct payload_req *req);
-	int ProcessGetTrafficParam(struct payload_req *req);
-	int ProcessGetFlashParam(struct payload_req *req);
-
-	int ProcessControl(struct payload_req *req);
+	int ProcessSetAllParam(struct payload_req *req, char *buf);
+	void PostCalibrateTime(const Ldczn_time *ldczn_time, struct payload_req *req);
+
+	int ProcessGetAllParam(struct payload_req *req, char *buf);
+	int ProcessGetMetrics(struct payload_req *req, char *buf);
+	int ReturnCachedAck(struct payload_req *req, int group);
+	bool ReturnNotModified(struct payload_req *req, unsigned int gen);
+
+	int ProcessControl(struct payload_req *req, char *buf);
+	int ProcessSubscribe(struct payload_req *req, char *buf);
+
+	void Notify(unsigned int event, unsigned int gen, const void *data,
+		    unsigned int len);
+	void NotifyParam(int group);
+	void NotifyGroup(int group);
+	void Forward(unsigned int event, const void *data, unsigned int len);
+	void FlushNotified();
 	
 	int ReturnAck(struct payload_req *req);
+	int ReturnStatus(struct payload_req *req, unsigned int status);
 	int SendToClient(char *buf, int len);
+	int SendShared(char *head, int head_len, struct TxBuffer *buf,
+		       unsigned int off, unsigned int len);
 };
 
 #endif
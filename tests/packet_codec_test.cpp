@@ -0,0 +1,134 @@
+/**
+ * @file	packet_codec_test.cpp
+ * @brief	payload_view越界拒绝和ack_fill应答写入的单元测试
+ * @author	agent <agent@local>
+ * @version	1.0.0
+ * @date	2026-10-17
+ *
+ * @verbatim
+ * ============================================================================
+ * Copyright (c) Shenzhen Landun technology Co.,Ltd. 2026
+ * All rights reserved. 
+ * 
+ * Use of this software is controlled by the terms and conditions found in the
+ * license agreenment under which this software has been supplied or provided.
+ * ============================================================================
+ * 
+ * @endverbatim
+ * 
+ */
+
+/*
+ * 独立可执行程序，不依赖设备环境，全部通过返回0:
+ *   g++ -I.. -I<ldczn_protocol.h所在目录> -o packet_codec_test packet_codec_test.cpp
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "packet_codec.h"
+
+static int failures = 0;
+
+#define CHECK(cond)							\
+	do {								\
+		if (!(cond)) {						\
+			printf("%s:%d: CHECK(%s) failed\n",		\
+			       __FILE__, __LINE__, #cond);		\
+			failures++;					\
+		}							\
+	} while (0)
+
+/* 长度不足、buf越过end时返回NULL，不读取负载 */
+static void test_payload_view_bounds()
+{
+	char buf[64] __attribute__((aligned(8)));
+	struct payload_req copy;
+	memset(buf, 0x5A, sizeof(buf));
+
+	CHECK(payload_view(buf, buf, &copy) == NULL);
+	CHECK(payload_view(buf, buf + sizeof(struct payload_req) - 1, &copy) == NULL);
+	CHECK(payload_view(buf + 8, buf, &copy) == NULL);
+
+	//未对齐且长度不足时同样拒绝，不拷贝
+	memset(&copy, 0, sizeof(copy));
+	CHECK(payload_view(buf + 1, buf + sizeof(struct payload_req), &copy) == NULL);
+	CHECK(copy.id == 0 && copy.type == 0);
+}
+
+/* 长度足够时: 对齐返回原地址，未对齐拷贝到copy */
+static void test_payload_view_fits()
+{
+	char buf[64] __attribute__((aligned(8)));
+	struct payload_req req = { 0x12345678, 0x04010000 };
+	struct payload_req copy;
+
+	memset(buf, 0, sizeof(buf));
+	memcpy(buf, &req, sizeof(req));
+	const struct payload_req *view = payload_view(buf, buf + sizeof(req), &copy);
+	CHECK(view == (const struct payload_req *)buf);
+
+	memcpy(buf + 1, &req, sizeof(req));
+	view = payload_view(buf + 1, buf + 1 + sizeof(req), &copy);
+	CHECK(view == &copy);
+	CHECK(view != NULL && view->id == req.id && view->type == req.type);
+}
+
+/* 定长应答: 包头各字段和payload_ack，msg_size为sizeof(P) */
+static void test_ack_fill_fixed()
+{
+	struct packet_ack packet;
+	const char magic[] = PROTOCOL_MAGIC;
+	char zero[sizeof(packet.head.auth_code)];
+	memset(&packet, 0xFF, sizeof(packet));
+	memset(zero, 0, sizeof(zero));
+
+	CHECK(ack_fill(&packet, 7, REQ_TYPE_CONTROL, ACK_EXT_BUSY) == &packet);
+	CHECK(memcmp(packet.head.magic, magic, sizeof(magic)) == 0);
+	CHECK(packet.head.protocol_major == PROTOCOL_MAJOR);
+	CHECK(packet.head.protocol_minor == PROTOCOL_MINOR);
+	CHECK(packet.head.encoding == ENCODING_TYPE_RAW);
+	CHECK(memcmp(packet.head.auth_code, zero, sizeof(zero)) == 0);
+	CHECK(packet.head.msg_type == MESSAGE_TYPE_ACK);
+	CHECK(packet.head.msg_size == sizeof(packet));
+	CHECK(packet.ack.id == 7);
+	CHECK(packet.ack.type == REQ_TYPE_CONTROL);
+	CHECK(packet.ack.status == ACK_EXT_BUSY);
+}
+
+/* 变长应答: msg_size取调用方给出的整包长度，包头之后的数据不被改写 */
+static void test_ack_fill_variable()
+{
+	char out[sizeof(struct packet_ext_ack) + 2 * sizeof(struct param_status)]
+		__attribute__((aligned(4)));
+	struct packet_ext_ack *packet = (struct packet_ext_ack *)out;
+	struct param_status *result = (struct param_status *)(packet + 1);
+	result[0].type = 1;
+	result[0].status = ACK_SUCCESS;
+	result[1].type = 2;
+	result[1].status = ACK_EXT_NOT_APPLIED;
+
+	ack_fill(packet, sizeof(out), 9, REQ_TYPE_SET_PARAMETER | PARAM_TYPE_ALL,
+		 ACK_EXT_FAILED);
+	CHECK(packet->head.msg_type == MESSAGE_TYPE_ACK);
+	CHECK(packet->head.msg_size == sizeof(out));
+	CHECK(packet->ack.id == 9);
+	CHECK(packet->ack.type == (REQ_TYPE_SET_PARAMETER | PARAM_TYPE_ALL));
+	CHECK(packet->ack.status == ACK_EXT_FAILED);
+	CHECK(result[0].type == 1 && result[0].status == ACK_SUCCESS);
+	CHECK(result[1].type == 2 && result[1].status == ACK_EXT_NOT_APPLIED);
+}
+
+int main()
+{
+	test_payload_view_bounds();
+	test_payload_view_fits();
+	test_ack_fill_fixed();
+	test_ack_fill_variable();
+
+	if (failures != 0) {
+		printf("packet_codec: %d check(s) failed\n", failures);
+		return 1;
+	}
+	printf("packet_codec: all checks passed\n");
+	return 0;
+}
@@ -0,0 +1,218 @@
+/**
+ * @file	timer_wheel.cpp
+ * @brief	分级时间轮类实现
+ * @author	agent <agent@local>
+ * @version 	1.0.0
+ * @date 	2026-10-16
+ *
+ * @verbatim
+ * ============================================================================
+ * Copyright (c) Shenzhen Landun technology Co.,Ltd. 2026
+ * All rights reserved. 
+ * 
+ * Use of this software is controlled by the terms and conditions found in the
+ * license agreenment under which this software has been supplied or provided.
+ * ============================================================================
+ * 
+ * @endverbatim
+ * 
+ */
+
+
+#include <unistd.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/timerfd.h>
+#include "debug.h"
+#include "timer_wheel.h"
+
+
+TimerWheel::TimerWheel()
+{
+	_timer_fd = -1;
+	_armed = false;
+	_count = 0;
+	_now = Ticks();
+	memset(_root, 0, sizeof(_root));
+	memset(_levels, 0, sizeof(_levels));
+	_expired = NULL;
+}
+
+TimerWheel::~TimerWheel()
+{
+	if (_timer_fd >= 0)
+		close(_timer_fd);
+}
+
+int TimerWheel::Init()
+{
+	_timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (_timer_fd < 0) {
+		Debug("create timer wheel failed");
+		return -1;
+	}
+
+	_now = Ticks();
+	return 0;
+}
+
+unsigned long long TimerWheel::Ticks()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((unsigned long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000) /
+		TIMER_TICK_MS;
+}
+
+unsigned long long TimerWheel::MsToTicks(unsigned int ms)
+{
+	return (ms + TIMER_TICK_MS - 1) / TIMER_TICK_MS;
+}
+
+void TimerWheel::Arm(bool on)
+{
+	if (_timer_fd < 0 || on == _armed)
+		return;
+
+	struct itimerspec its;
+	memset(&its, 0, sizeof(its));
+	if (on) {
+		its.it_value.tv_nsec    = TIMER_TICK_MS * 1000000;
+		its.it_interval.tv_nsec = TIMER_TICK_MS * 1000000;
+	}
+	timerfd_settime(_timer_fd, 0, &its, NULL);
+	_armed = on;
+}
+
+void TimerWheel::Link(struct Timer **head, struct Timer *timer)
+{
+	timer->next = *head;
+	if (*head != NULL)
+		(*head)->pprev = &timer->next;
+	*head = timer;
+	timer->pprev = head;
+}
+
+/* 按剩余tick数放入对应的级和格 */
+void TimerWheel::Place(struct Timer *timer)
+{
+	if (timer->expires <= _now)
+		timer->expires = _now + 1;
+
+	unsigned long long delta = timer->expires - _now;
+	unsigned long long expires = timer->expires;
+	if (delta < TIMER_ROOT_SIZE) {
+		Link(&_root[expires & (TIMER_ROOT_SIZE - 1)], timer);
+		return;
+	}
+
+	for (int level = 0; level < TIMER_LEVELS - 1; level++) {
+		int shift = TIMER_ROOT_BITS + (level + 1) * TIMER_LEVEL_BITS;
+		if (delta < (1ULL << shift) || level == TIMER_LEVELS - 2) {
+			if (delta >= (1ULL << shift)) {
+				//超出时间轮范围，放在最后一级最远处，到时再重新计算
+				expires = _now + (1ULL << shift) - 1;
+				timer->expires = expires;
+			}
+			int index = (expires >> (shift - TIMER_LEVEL_BITS)) &
+				    (TIMER_LEVEL_SIZE - 1);
+			Link(&_levels[level][index], timer);
+			return;
+		}
+	}
+}
+
+/**
+ * @function	void Add(struct Timer *timer, unsigned long long expires)
+ * @brief	在expires(Ticks()计时)到期，已加入的定时器重新设置到期时间
+ *
+ */
+void TimerWheel::Add(struct Timer *timer, unsigned long long expires)
+{
+	if (timer_pending(timer))
+		Del(timer);
+
+	timer->expires = expires;
+	Place(timer);
+	_count++;
+	Arm(true);
+}
+
+void TimerWheel::Del(struct Timer *timer)
+{
+	if (!timer_pending(timer))
+		return;
+
+	*timer->pprev = timer->next;
+	if (timer->next != NULL)
+		timer->next->pprev = timer->pprev;
+	timer->next = NULL;
+	timer->pprev = NULL;
+	_count--;
+}
+
+/* 上一级的一格到期，其中的定时器重新放入下一级 */
+void TimerWheel::Cascade(int level, unsigned int index)
+{
+	struct Timer *timer = _levels[level][index];
+	_levels[level][index] = NULL;
+	while (timer != NULL) {
+		struct Timer *next = timer->next;
+		Place(timer);
+		timer = next;
+	}
+}
+
+/**
+ * @function	void Expire()
+ * @brief	timerfd可读时调用，推进到当前tick并把到期定时器移入到期链表
+ *
+ */
+void TimerWheel::Expire()
+{
+	uint64_t count;
+	ssize_t ret = read(_timer_fd, &count, sizeof(count));
+	ret = ret;
+
+	unsigned long long now = Ticks();
+	while (_now < now) {
+		_now++;
+		unsigned int index = _now & (TIMER_ROOT_SIZE - 1);
+		for (int level = 0; index == 0 && level < TIMER_LEVELS - 1; level++) {
+			int shift = TIMER_ROOT_BITS + level * TIMER_LEVEL_BITS;
+			index = (_now >> shift) & (TIMER_LEVEL_SIZE - 1);
+			Cascade(level, index);
+		}
+
+		struct Timer *timer = _root[_now & (TIMER_ROOT_SIZE - 1)];
+		_root[_now & (TIMER_ROOT_SIZE - 1)] = NULL;
+		while (timer != NULL) {
+			struct Timer *next = timer->next;
+			Link(&_expired, timer);
+			timer = next;
+		}
+
+		if (_count == 0)
+			_now = now;
+	}
+}
+
+/**
+ * @function	struct Timer *Next()
+ * @brief	取出一个到期的定时器(已不在时间轮中)，没有时返回NULL并在
+ *		时间轮为空时停止timerfd
+ *
+ */
+struct Timer *TimerWheel::Next()
+{
+	struct Timer *timer = _expired;
+	if (timer == NULL) {
+		if (_count == 0)
+			Arm(false);
+		return NULL;
+	}
+
+	Del(timer);
+	return timer;
+}
@@ -0,0 +1,94 @@
+/**
+ * @file	timer_wheel.h
+ * @brief	分级时间轮类声明
+ * @author	agent <agent@local>
+ * @version	1.0.0
+ * @date	2026-10-16
+ *
+ * @verbatim
+ * ============================================================================
+ * Copyright (c) Shenzhen Landun technology Co.,Ltd. 2026
+ * All rights reserved. 
+ * 
+ * Use of this software is controlled by the terms and conditions found in the
+ * license agreenment under which this software has been supplied or provided.
+ * ============================================================================
+ * 
+ * @endverbatim
+ * 
+ */
+
+
+#ifndef _TIMERWHEEL_H_
+#define _TIMERWHEEL_H_
+
+#define TIMER_TICK_MS		100	//时间轮精度
+#define TIMER_ROOT_BITS		8	//第一级256格
+#define TIMER_LEVEL_BITS	6	//其余各级64格
+#define TIMER_LEVELS		4	//最长约(2^26)*100ms，超出按最大值处理
+
+#define TIMER_ROOT_SIZE		(1 << TIMER_ROOT_BITS)
+#define TIMER_LEVEL_SIZE	(1 << TIMER_LEVEL_BITS)
+
+struct Timer {
+	struct Timer  *next;
+	struct Timer **pprev;		//NULL表示未加入
+	unsigned long long expires;	//到期tick
+	int   type;			//使用者定义的定时器类型
+	void *arg;
+};
+
+static inline void timer_init(struct Timer *timer, int type, void *arg)
+{
+	timer->next  = 0;
+	timer->pprev = 0;
+	timer->expires = 0;
+	timer->type  = type;
+	timer->arg   = arg;
+}
+
+static inline bool timer_pending(const struct Timer *timer)
+{
+	return timer->pprev != 0;
+}
+
+/**
+ * 用一个timerfd驱动的分级时间轮，添加、删除定时器均为O(1)，
+ * 适合大量连接的空闲/心跳/写超时。有定时器时timerfd按TIMER_TICK_MS
+ * 周期触发，Expire()把到期的定时器移入到期链表，由使用者用Next()逐个取出处理。
+ */
+class TimerWheel
+{
+
+public:
+	TimerWheel();
+	~TimerWheel();
+
+	int  Init();
+	int  Fd() const { return _timer_fd; }
+
+	static unsigned long long Ticks();
+	static unsigned long long MsToTicks(unsigned int ms);
+
+	void Add(struct Timer *timer, unsigned long long expires);
+	void Del(struct Timer *timer);
+	void Expire();
+	struct Timer *Next();
+
+private:
+	int  _timer_fd;
+	bool _armed;
+	unsigned int _count;		//已加入的定时器数
+	unsigned long long _now;	//已处理到的tick
+
+	struct Timer *_root[TIMER_ROOT_SIZE];
+	struct Timer *_levels[TIMER_LEVELS - 1][TIMER_LEVEL_SIZE];
+	struct Timer *_expired;
+
+	void Link(struct Timer **head, struct Timer *timer);
+	void Place(struct Timer *timer);
+	void Cascade(int level, unsigned int index);
+	void Arm(bool on);
+};
+
+#endif
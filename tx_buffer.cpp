@@ -0,0 +1,70 @@
+/**
+ * @file	tx_buffer.cpp
+ * @brief	引用计数发送缓冲实现
+ * @author	agent <agent@local>
+ * @version 	1.0.0
+ * @date 	2026-10-16
+ *
+ * @verbatim
+ * ============================================================================
+ * Copyright (c) Shenzhen Landun technology Co.,Ltd. 2026
+ * All rights reserved. 
+ * 
+ * Use of this software is controlled by the terms and conditions found in the
+ * license agreenment under which this software has been supplied or provided.
+ * ============================================================================
+ * 
+ * @endverbatim
+ * 
+ */
+
+
+#include <stdlib.h>
+#include <stddef.h>
+#include "slab.h"
+#include "tx_buffer.h"
+
+#define TX_BUFFER_POOL_SIZE	(offsetof(struct TxBuffer, data) + TX_BUFFER_MIN_SIZE)
+
+//应答和通知包都小于TX_BUFFER_MIN_SIZE，稳定运行后不再malloc；
+//引用可能在其他reactor中释放，池加锁
+static Slab tx_pool(TX_BUFFER_POOL_SIZE, 32, true, TX_BUFFER_RESERVE);
+
+struct TxBuffer *tx_buffer_alloc(unsigned int size)
+{
+	struct TxBuffer *buf;
+	if (size <= TX_BUFFER_MIN_SIZE) {
+		size = TX_BUFFER_MIN_SIZE;
+		buf = (struct TxBuffer *)tx_pool.Alloc();
+	} else {
+		buf = (struct TxBuffer *)malloc(offsetof(struct TxBuffer, data) + size);
+	}
+	if (buf == NULL)
+		return NULL;
+
+	buf->refs = 1;
+	buf->size = size;
+	buf->len  = 0;
+	return buf;
+}
+
+void tx_buffer_get(struct TxBuffer *buf)
+{
+	__sync_fetch_and_add(&buf->refs, 1);
+}
+
+void tx_buffer_put(struct TxBuffer *buf)
+{
+	if (__sync_sub_and_fetch(&buf->refs, 1) != 0)
+		return;
+
+	if (buf->size == TX_BUFFER_MIN_SIZE)
+		tx_pool.Free(buf);
+	else
+		free(buf);
+}
+
+void tx_buffer_stat(struct SlabStat *stat)
+{
+	tx_pool.GetStat(stat);
+}
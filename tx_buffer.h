@@ -0,0 +1,43 @@
+/**
+ * @file	tx_buffer.h
+ * @brief	引用计数发送缓冲声明
+ * @author	agent <agent@local>
+ * @version	1.0.0
+ * @date	2026-10-16
+ *
+ * @verbatim
+ * ============================================================================
+ * Copyright (c) Shenzhen Landun technology Co.,Ltd. 2026
+ * All rights reserved. 
+ * 
+ * Use of this software is controlled by the terms and conditions found in the
+ * license agreenment under which this software has been supplied or provided.
+ * ============================================================================
+ * 
+ * @endverbatim
+ * 
+ */
+
+
+#ifndef _TXBUFFER_H_
+#define _TXBUFFER_H_
+
+#define TX_BUFFER_MIN_SIZE	2048	//不超过该长度的缓冲取自对象池
+#define TX_BUFFER_RESERVE	64	//启动时预先申请的池缓冲数
+
+struct SlabStat;
+
+//发送缓冲可被多个连接的输出队列共享，最后一个引用释放时回收
+struct TxBuffer {
+	int refs;		//引用计数
+	unsigned int size;	//data容量
+	unsigned int len;	//已填充长度
+	char data[1];
+};
+
+struct TxBuffer *tx_buffer_alloc(unsigned int size);
+void tx_buffer_get(struct TxBuffer *buf);
+void tx_buffer_put(struct TxBuffer *buf);
+void tx_buffer_stat(struct SlabStat *stat);
+
+#endif
@@ -0,0 +1,167 @@
+/**
+ * @file	udp_control.cpp
+ * @brief	UDP控制通道类实现
+ * @author	agent <agent@local>
+ * @version 	1.0.0
+ * @date 	2026-10-16
+ *
+ * @verbatim
+ * ============================================================================
+ * Copyright (c) Shenzhen Landun technology Co.,Ltd. 2026
+ * All rights reserved. 
+ * 
+ * Use of this software is controlled by the terms and conditions found in the
+ * license agreenment under which this software has been supplied or provided.
+ * ============================================================================
+ * 
+ * @endverbatim
+ * 
+ */
+
+
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include "debug.h"
+#include "udp_control.h"
+
+
+UdpControl::UdpControl()
+{
+	_sock = -1;
+	memset(_peers, 0, sizeof(_peers));
+}
+
+UdpControl::~UdpControl()
+{
+	Close();
+}
+
+int UdpControl::Open(int port)
+{
+	_sock = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (_sock < 0) {
+		Debug("create udp socket failed");
+		return -1;
+	}
+
+	int on = 1;
+	setsockopt(_sock, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family		= AF_INET;
+	addr.sin_addr.s_addr	= htonl(INADDR_ANY);
+	addr.sin_port		= htons(port);
+	if (bind(_sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		Debug("bind udp port %d failed", port);
+		Close();
+		return -1;
+	}
+
+	return 0;
+}
+
+void UdpControl::Close()
+{
+	if (_sock >= 0) {
+		close(_sock);
+		_sock = -1;
+	}
+}
+
+/**
+ * @function	int Recv(char *buf, int len, struct sockaddr_in *from)
+ * @brief	非阻塞接收一个报文
+ * @return	报文长度，0表示已读空，-1出错
+ */
+int UdpControl::Recv(char *buf, int len, struct sockaddr_in *from)
+{
+	while (1) {
+		socklen_t addrlen = sizeof(*from);
+		ssize_t ret = recvfrom(_sock, buf, len, 0, (struct sockaddr *)from,
+				       &addrlen);
+		if (ret >= 0)
+			return ret;
+		if (errno == EINTR)
+			continue;
+		if (errno == EAGAIN || errno == EWOULDBLOCK)
+			return 0;
+		return -1;
+	}
+}
+
+int UdpControl::Reply(const struct sockaddr_in *to, const char *buf, int len)
+{
+	return sendto(_sock, buf, len, MSG_DONTWAIT, (const struct sockaddr *)to,
+		      sizeof(*to));
+}
+
+/**
+ * @function	struct Peer *FindPeer(const struct sockaddr_in *from, time_t now)
+ * @brief	查找客户端的窗口，没有时占用空闲项或最久未活动的项
+ *
+ */
+struct UdpControl::Peer *UdpControl::FindPeer(const struct sockaddr_in *from,
+					      time_t now)
+{
+	struct Peer *victim = &_peers[0];
+	for (int i = 0; i < UDP_PEER_MAX; i++) {
+		struct Peer *peer = &_peers[i];
+		if (peer->used && peer->addr == from->sin_addr.s_addr &&
+		    peer->port == from->sin_port) {
+			if (now - peer->last > UDP_PEER_IDLE_SEC)
+				peer->used = false;
+			return peer;
+		}
+		if (!victim->used)
+			continue;
+		if (!peer->used || peer->last < victim->last)
+			victim = peer;
+	}
+
+	victim->used = false;
+	victim->addr = from->sin_addr.s_addr;
+	victim->port = from->sin_port;
+	return victim;
+}
+
+/**
+ * @function	int Check(const struct sockaddr_in *from, unsigned int seq)
+ * @brief	按客户端的滑动窗口检查并记录序号，序号回绕按32位差值比较
+ * @return	UDP_SEQ_NEW, UDP_SEQ_DUPLICATE或UDP_SEQ_STALE
+ */
+int UdpControl::Check(const struct sockaddr_in *from, unsigned int seq)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	struct Peer *peer = FindPeer(from, ts.tv_sec);
+	peer->last = ts.tv_sec;
+	if (!peer->used) {
+		peer->used   = true;
+		peer->top    = seq;
+		peer->bitmap = 1;
+		return UDP_SEQ_NEW;
+	}
+
+	int diff = (int)(seq - peer->top);
+	if (diff > 0) {
+		peer->bitmap = diff < UDP_REPLAY_WINDOW ? peer->bitmap << diff : 0;
+		peer->bitmap |= 1;
+		peer->top = seq;
+		return UDP_SEQ_NEW;
+	}
+
+	unsigned int off = -diff;
+	if (off >= UDP_REPLAY_WINDOW)
+		return UDP_SEQ_STALE;
+
+	uint64_t bit = (uint64_t)1 << off;
+	if (peer->bitmap & bit)
+		return UDP_SEQ_DUPLICATE;
+
+	peer->bitmap |= bit;
+	return UDP_SEQ_NEW;
+}
@@ -0,0 +1,75 @@
+/**
+ * @file	udp_control.h
+ * @brief	UDP控制通道类声明
+ * @author	agent <agent@local>
+ * @version	1.0.0
+ * @date	2026-10-16
+ *
+ * @verbatim
+ * ============================================================================
+ * Copyright (c) Shenzhen Landun technology Co.,Ltd. 2026
+ * All rights reserved. 
+ * 
+ * Use of this software is controlled by the terms and conditions found in the
+ * license agreenment under which this software has been supplied or provided.
+ * ============================================================================
+ * 
+ * @endverbatim
+ * 
+ */
+
+
+#ifndef _UDPCONTROL_H_
+#define _UDPCONTROL_H_
+
+#include <stdint.h>
+#include <time.h>
+#include <netinet/in.h>
+
+#define UDP_CONTROL_PORT	39002	//与TCP服务同一端口
+#define UDP_REPLAY_WINDOW	64	//序号滑动窗口大小
+#define UDP_PEER_MAX		32	//同时跟踪的客户端数
+#define UDP_PEER_IDLE_SEC	60	//客户端空闲多久后丢弃其窗口(允许客户端重启后序号从头开始)
+
+//Check()返回值
+#define UDP_SEQ_NEW		0	//新序号，需处理
+#define UDP_SEQ_DUPLICATE	1	//窗口内已处理过的序号，只重发应答
+#define UDP_SEQ_STALE		-1	//早于窗口的序号，丢弃
+
+/**
+ * 心跳和手动抓拍的UDP通道，报文格式与TCP相同(header_std + payload_req)，
+ * req.id作为序号。每个客户端地址维护一个滑动窗口位图，重复的序号不会
+ * 再次执行(客户端因应答丢失而重发时仍会收到应答)，早于窗口的报文丢弃。
+ */
+class UdpControl
+{
+
+public:
+	UdpControl();
+	~UdpControl();
+
+	int  Open(int port);
+	void Close();
+	int  Fd() const { return _sock; }
+
+	int  Recv(char *buf, int len, struct sockaddr_in *from);
+	int  Reply(const struct sockaddr_in *to, const char *buf, int len);
+	int  Check(const struct sockaddr_in *from, unsigned int seq);
+
+private:
+	struct Peer {
+		uint32_t addr;		//网络字节序
+		uint16_t port;
+		bool	 used;
+		unsigned int top;	//已收到的最大序号
+		uint64_t bitmap;	//bit n表示序号top-n已收到
+		time_t	 last;		//最后收到报文的时间
+	};
+
+	int  _sock;
+	struct Peer _peers[UDP_PEER_MAX];
+
+	struct Peer *FindPeer(const struct sockaddr_in *from, time_t now);
+};
+
+#endif
@@ -0,0 +1,702 @@
+/**
+ * @file	upgrade_receiver.cpp
+ * @brief	升级文件流式接收类实现
+ * @author	agent <agent@local>
+ * @version 	1.0.0
+ * @date 	2026-10-16
+ *
+ * @verbatim
+ * ============================================================================
+ * Copyright (c) Shenzhen Landun technology Co.,Ltd. 2026
+ * All rights reserved. 
+ * 
+ * Use of this software is controlled by the terms and conditions found in the
+ * license agreenment under which this software has been supplied or provided.
+ * ============================================================================
+ * 
+ * @endverbatim
+ * 
+ */
+
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/stat.h>
+#include "debug.h"
+#include "crc32c.h"
+#include "work_pool.h"
+#include "io_ring.h"
+#include "upgrade_receiver.h"
+
+
+static inline unsigned int elapsed_ms(const struct timespec *start)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start->tv_sec) * 1000 +
+		(now.tv_nsec - start->tv_nsec) / 1000000;
+}
+
+UpgradeReceiver::UpgradeReceiver(unsigned int req_type)
+{
+	_req_type = req_type;
+	_fd = -1;
+	_error = false;
+	_resumable = false;
+	_path[0] = '\0';
+	_final[0] = '\0';
+	_total = 0;
+	_received = 0;
+	_durable = 0;
+	_durable_crc = 0;
+	_crc = 0;
+	_verify = false;
+	_expect_crc = 0;
+	_elapsed_ms = 0;
+	_sync_posted = 0;
+	_bufs[0] = NULL;
+	_bufs[1] = NULL;
+	_cur = 0;
+	_buf = NULL;
+	_fill = 0;
+	_writing = false;
+	_pool = NULL;
+	_conn_id = 0;
+	_jobs = 0;
+	_orphan = false;
+	_ring = NULL;
+	_use_ring = false;
+}
+
+UpgradeReceiver::~UpgradeReceiver()
+{
+	Abort();
+	CloseRing();
+	free(_bufs[0]);
+	free(_bufs[1]);
+}
+
+/**
+ * @function	void SetPool(WorkPool *pool, unsigned int conn_id)
+ * @brief	写盘交给工作线程，conn_id为完成时应答的连接；未设置时在调用线程中写盘
+ *
+ */
+void UpgradeReceiver::SetPool(WorkPool *pool, unsigned int conn_id)
+{
+	_pool = pool;
+	_conn_id = conn_id;
+}
+
+/* 检查文件名，生成临时文件/data/<file_name>.part和安装文件的路径 */
+int UpgradeReceiver::SetTarget(const char *file_name)
+{
+	if (file_name[0] == '\0' || strchr(file_name, '/') != NULL ||
+	    strcmp(file_name, ".") == 0 || strcmp(file_name, "..") == 0) {
+		Debug("bad upgrade file name");
+		return -1;
+	}
+
+	snprintf(_final, sizeof(_final), "%s%s", UPGRADE_DIR, file_name);
+	snprintf(_path, sizeof(_path), "%s.part", _final);
+	return 0;
+}
+
+/* 打开临时文件，在存储工作线程中调用 */
+int UpgradeReceiver::OpenTarget(int flags)
+{
+	CloseRing();
+	_fd = open(_path, O_WRONLY | O_CREAT | O_CLOEXEC | flags, 0644);
+	if (_fd < 0) {
+		Debug("open %s failed", _path);
+		return -1;
+	}
+
+	return 0;
+}
+
+bool UpgradeReceiver::Matches(const char *file_name, unsigned int total_length) const
+{
+	char path[512];
+	snprintf(path, sizeof(path), "%s%s.part", UPGRADE_DIR, file_name);
+	return total_length == _total && strcmp(path, _path) == 0;
+}
+
+/**
+ * @function	int PostOpen(const struct payload_req *req, void (*run)(struct Work *))
+ * @brief	打开文件的操作在存储工作线程中执行，排在本对象后续的写盘之前；
+ *		未设置工作线程时直接执行
+ * @return	已提交返回0，直接执行时返回执行结果
+ */
+int UpgradeReceiver::PostOpen(const struct payload_req *req, void (*run)(struct Work *))
+{
+	struct Work *work = WorkPool::Alloc(WORK_CLASS_STORAGE, WORK_UPGRADE_OPEN, run);
+	work->arg	= this;
+	work->conn_id	= _conn_id;
+	if (req != NULL)
+		work->req = *req;
+	if (_pool == NULL) {
+		run(work);
+		int ret = work->result;
+		WorkPool::Free(work);
+		return ret;
+	}
+
+	_jobs++;
+	_pool->Post(work);
+	return 0;
+}
+
+/**
+ * @function	int Resume(const struct payload_req *req, const char *file_name,
+ *			   unsigned int total_length)
+ * @brief	开始或续接分块传输: 打开临时文件、回读已落盘部分的CRC32C在存储
+ *		工作线程中执行，完成后以WORK_UPGRADE_OPEN任务回复req的进度
+ * @return	0已提交，-1文件名非法或内存不足
+ */
+int UpgradeReceiver::Resume(const struct payload_req *req, const char *file_name,
+			    unsigned int total_length)
+{
+	_resumable = true;
+	_total = total_length;
+	clock_gettime(CLOCK_MONOTONIC, &_start);
+
+	if (AllocBuffers() < 0 || SetTarget(file_name) < 0)
+		return -1;
+
+	return PostOpen(req, ReopenJob);
+}
+
+void UpgradeReceiver::ReopenJob(struct Work *work)
+{
+	UpgradeReceiver *receiver = (UpgradeReceiver *)work->arg;
+	work->result = receiver->Reopen();
+}
+
+/**
+ * @function	int Reopen()
+ * @brief	打开分块传输的临时文件，已有临时文件的长度即为已落盘字节数；
+ *		总长度不一致时视为新文件重新开始
+ * @return	0成功，-1失败
+ */
+int UpgradeReceiver::Reopen()
+{
+	unsigned int total_length = _total;
+	if (OpenTarget(0) < 0)
+		return -1;
+
+	struct stat st;
+	if (fstat(_fd, &st) < 0 || st.st_size > (off_t)total_length) {
+		st.st_size = 0;
+		if (ftruncate(_fd, 0) < 0) {
+			Abort();
+			return -1;
+		}
+	}
+
+	//预分配使用KEEP_SIZE，文件长度只随已写入的数据增长
+	if (total_length > (unsigned int)st.st_size &&
+	    fallocate(_fd, FALLOC_FL_KEEP_SIZE, st.st_size,
+		      total_length - st.st_size) < 0 &&
+	    errno != EOPNOTSUPP && errno != ENOSYS) {
+		Debug("no space for %u bytes", total_length);
+		Abort();
+		return -1;
+	}
+
+	if (CrcPrefix(st.st_size) < 0) {
+		Abort();
+		return -1;
+	}
+
+	_received = st.st_size;
+	_durable = st.st_size;
+	_durable_crc = _crc;
+	_sync_posted = st.st_size;
+	return 0;
+}
+
+/**
+ * @function	int CrcPrefix(unsigned int len)
+ * @brief	续传时回读已落盘部分计算CRC32C，每次续接只需一次；
+ *		借用尚未接收数据的接收缓冲
+ *
+ */
+int UpgradeReceiver::CrcPrefix(unsigned int len)
+{
+	if (len == 0)
+		return 0;
+
+	char *buf = _bufs[0];
+
+	int fd = open(_path, O_RDONLY | O_CLOEXEC);
+	unsigned int off = 0;
+	while (fd >= 0 && off < len) {
+		unsigned int n = len - off;
+		if (n > UPGRADE_BUF_SIZE)
+			n = UPGRADE_BUF_SIZE;
+		ssize_t ret = pread(fd, buf, n, off);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret <= 0)
+			break;
+		_crc = crc32c(_crc, buf, ret);
+		off += ret;
+	}
+
+	if (fd >= 0)
+		close(fd);
+	return off == len ? 0 : -1;
+}
+
+/* 在offset处写入len字节，返回0成功，-1失败 */
+static int write_at(int fd, const char *data, unsigned int len, unsigned int offset)
+{
+	unsigned int off = 0;
+	while (off < len) {
+		ssize_t ret = pwrite(fd, data + off, len - off, offset + off);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret <= 0) {
+			Debug("Write data to file failed");
+			return -1;
+		}
+		off += ret;
+	}
+
+	return 0;
+}
+
+/**
+ * @function	int WriteChunk(unsigned int offset, const char *data, unsigned int len)
+ * @brief	分块数据拷入接收缓冲，由PostSync交给存储工作线程写出，
+ *		写盘失败在随后的落盘进度中以ACK_EXT_FAILED返回
+ * @return	0成功，-1偏移不连续或越界，-2接收缓冲不可用
+ */
+int UpgradeReceiver::WriteChunk(unsigned int offset, const char *data, unsigned int len)
+{
+	if (offset != _received || len > _total - _received)
+		return -1;
+
+	if (_buf == NULL || Feed(data, len) != len) {
+		Debug("upgrade chunk buffer unavailable");
+		return -2;
+	}
+	return 0;
+}
+
+void UpgradeReceiver::SyncJob(struct Work *work)
+{
+	UpgradeReceiver *receiver = (UpgradeReceiver *)work->arg;
+	//之前的分块写盘在同一队列中已执行完，出错时不更新进度
+	work->result = receiver->_error ? -1 : fdatasync(receiver->_fd);
+}
+
+/**
+ * @function	void PostSync(const struct payload_req *req)
+ * @brief	先写出缓冲中的数据块，再在工作线程中落盘，完成后Durable()更新并
+ *		回复req的进度；落盘完成前连接不处理后续请求，另一个缓冲总是空闲的
+ *
+ */
+void UpgradeReceiver::PostSync(const struct payload_req *req)
+{
+	if (_fill > 0)
+		Submit();
+
+	struct Work *work = WorkPool::Alloc(WORK_CLASS_STORAGE, WORK_UPGRADE_SYNC, SyncJob);
+	work->arg	= this;
+	work->value	= _received;
+	work->len	= _crc;		//落盘位置对应的CRC32C
+	work->conn_id	= _conn_id;
+	work->req	= *req;
+	_sync_posted = _received;
+	_jobs++;
+	_pool->Post(work);
+}
+
+void UpgradeReceiver::FinishJob(struct Work *work)
+{
+	UpgradeReceiver *receiver = (UpgradeReceiver *)work->arg;
+	work->result = receiver->Finish(work->len != 0, work->value);
+}
+
+/**
+ * @function	void PostFinish(const struct payload_req *req, bool verify, unsigned int crc)
+ * @brief	在工作线程中写出剩余数据、落盘、校验并安装，排在已提交的写盘之后；
+ *		调用后本对象归该任务所有，完成处理中删除
+ *
+ */
+void UpgradeReceiver::PostFinish(const struct payload_req *req, bool verify,
+				 unsigned int crc)
+{
+	struct Work *work = WorkPool::Alloc(WORK_CLASS_STORAGE, WORK_UPGRADE_FINISH, FinishJob);
+	work->arg	= this;
+	work->len	= verify;
+	work->value	= crc;
+	work->conn_id	= _conn_id;
+	if (req != NULL)
+		work->req = *req;
+	else
+		work->req.type = _req_type;
+	_jobs++;
+	_pool->Post(work);
+}
+
+/**
+ * @function	void JobDone(struct Work *work)
+ * @brief	reactor处理任务完成: 更新落盘进度和未完成任务数；
+ *		分块传输落盘失败时退回到上次落盘的位置
+ *
+ */
+void UpgradeReceiver::JobDone(struct Work *work)
+{
+	_jobs--;
+	if (work->type == WORK_UPGRADE_WRITE)
+		_writing = false;
+	if (work->type != WORK_UPGRADE_SYNC)
+		return;
+
+	if (work->result == 0 && work->value > _durable) {
+		_durable = work->value;
+		_durable_crc = work->len;
+	} else if (work->result < 0 && _resumable && _jobs == 0) {
+		Rollback();
+	}
+}
+
+/**
+ * @function	void Rollback()
+ * @brief	写盘或落盘失败后丢弃未落盘的数据并清除错误，客户端按进度应答中的
+ *		durable重传。落盘完成前连接不提交新任务，此时工作线程中没有本对象的任务
+ *
+ */
+void UpgradeReceiver::Rollback()
+{
+	Debug("upgrade write failed, rewind %u to %u", _received, _durable);
+	_received = _durable;
+	_crc = _durable_crc;
+	_sync_posted = _durable;
+	_fill = 0;
+	_error = false;
+}
+
+/**
+ * @function	int Begin(const char *file_name, unsigned int total_length)
+ * @brief	开始整包流式传输，/data/<file_name>.part的创建和预分配在存储工作线程
+ *		中执行；失败时仍收完total_length字节并丢弃，以保持请求流同步，收完后回失败
+ * @return	0成功，-1文件名非法或内存不足
+ */
+int UpgradeReceiver::Begin(const char *file_name, unsigned int total_length)
+{
+	_total = total_length;
+	_received = 0;
+	_fill = 0;
+	clock_gettime(CLOCK_MONOTONIC, &_start);
+
+	if (AllocBuffers() < 0 || SetTarget(file_name) < 0) {
+		_error = true;
+		return -1;
+	}
+
+	PostOpen(NULL, CreateJob);
+	return 0;
+}
+
+void UpgradeReceiver::CreateJob(struct Work *work)
+{
+	UpgradeReceiver *receiver = (UpgradeReceiver *)work->arg;
+	work->result = receiver->Create();
+}
+
+/* 创建临时文件并预分配空间，失败时置_error，之后的写盘都跳过 */
+int UpgradeReceiver::Create()
+{
+	if (OpenTarget(O_TRUNC) < 0) {
+		_error = true;
+		return -1;
+	}
+
+	//预分配可减少flash文件系统的碎片和元数据更新，不支持时忽略
+	if (_total > 0 &&
+	    fallocate(_fd, FALLOC_FL_KEEP_SIZE, 0, _total) < 0 &&
+	    errno != EOPNOTSUPP && errno != ENOSYS) {
+		Debug("no space for %u bytes", _total);
+		Abort();
+		_error = true;
+		return -1;
+	}
+
+	return 0;
+}
+
+/* 两个对齐的接收缓冲，每次升级申请一次 */
+int UpgradeReceiver::AllocBuffers()
+{
+	if (posix_memalign((void **)&_bufs[0], 4096, UPGRADE_BUF_SIZE) != 0 ||
+	    posix_memalign((void **)&_bufs[1], 4096, UPGRADE_BUF_SIZE) != 0)
+		return -1;
+
+	_cur = 0;
+	_buf = _bufs[0];
+	_fill = 0;
+	return 0;
+}
+
+/* 写入文件的offset处，出错后不再写，临时文件保持为连续的前缀 */
+int UpgradeReceiver::WriteOut(const char *buf, unsigned int len, unsigned int offset)
+{
+	if (_error)
+		return -1;
+
+	if (_use_ring && OpenRing())
+		return RingWrite(buf, len, offset);
+
+	if (write_at(_fd, buf, len, offset) < 0)
+		_error = true;
+
+	return _error ? -1 : 0;
+}
+
+/**
+ * @function	bool OpenRing()
+ * @brief	首次写盘时在写盘线程中创建io_uring并注册目标文件，
+ *		不支持时回到write()
+ */
+bool UpgradeReceiver::OpenRing()
+{
+	if (_ring != NULL)
+		return true;
+
+	_ring = new IoRing;
+	if (_ring->Init(UPGRADE_RING_ENTRIES) < 0 || !_ring->CanWriteFile() ||
+	    _ring->RegisterFiles(&_fd, 1) < 0) {
+		delete _ring;
+		_ring = NULL;
+		_use_ring = false;
+		return false;
+	}
+
+	return true;
+}
+
+/* 关闭目标文件前调用，释放固定文件的引用 */
+void UpgradeReceiver::CloseRing()
+{
+	delete _ring;
+	_ring = NULL;
+}
+
+/* 写固定文件的offset处 */
+int UpgradeReceiver::RingWrite(const char *buf, unsigned int len, unsigned int offset)
+{
+	unsigned int off = 0;
+	while (off < len && !_error) {
+		unsigned long long data;
+		int ret = -EIO;
+		if (_ring->PrepWriteFixed(0, buf + off, len - off,
+					  (unsigned long long)offset + off, 0) < 0 ||
+		    _ring->Submit(1) < 0 || !_ring->Reap(&data, &ret, NULL))
+			ret = -EIO;
+		if (ret <= 0) {
+			Debug("Write data to file failed");
+			_error = true;
+			break;
+		}
+		off += ret;
+	}
+
+	return _error ? -1 : 0;
+}
+
+void UpgradeReceiver::WriteJob(struct Work *work)
+{
+	UpgradeReceiver *receiver = (UpgradeReceiver *)work->arg;
+	work->result = receiver->WriteOut((const char *)work->ptr, work->len, work->value);
+}
+
+/**
+ * @function	int Submit()
+ * @brief	写出接收缓冲: 有工作线程时提交写盘并切换到另一个缓冲
+ * @return	0成功，-1另一个缓冲仍在写盘
+ */
+int UpgradeReceiver::Submit()
+{
+	if (_buf == NULL || _pool == NULL) {
+		if (_buf != NULL)
+			WriteOut(_buf, _fill, _received - _fill);
+		_fill = 0;
+		return 0;
+	}
+
+	if (_writing)
+		return -1;
+
+	struct Work *work = WorkPool::Alloc(WORK_CLASS_STORAGE, WORK_UPGRADE_WRITE, WriteJob);
+	work->arg	= this;
+	work->ptr	= _buf;
+	work->len	= _fill;
+	work->value	= _received - _fill;	//缓冲起始处的文件偏移
+	work->conn_id	= _conn_id;
+	_jobs++;
+	_writing = true;
+	_pool->Post(work);
+
+	_cur ^= 1;
+	_buf = _bufs[_cur];
+	_fill = 0;
+	return 0;
+}
+
+/**
+ * @function	unsigned int Feed(const char *data, unsigned int len)
+ * @brief	接收随升级请求一起到达、已在连接缓冲中的文件数据
+ * @return	本次消费的字节数，不超过剩余长度
+ */
+unsigned int UpgradeReceiver::Feed(const char *data, unsigned int len)
+{
+	unsigned int used = 0;
+	while (used < len && !Done()) {
+		if (_fill == UPGRADE_BUF_SIZE && Submit() < 0)
+			break;
+
+		unsigned int n = len - used;
+		if (n > _total - _received)
+			n = _total - _received;
+		if (n > UPGRADE_BUF_SIZE - _fill)
+			n = UPGRADE_BUF_SIZE - _fill;
+
+		if (_buf != NULL)
+			memcpy(_buf + _fill, data + used, n);
+		_crc = crc32c(_crc, data + used, n);
+		_fill += n;
+		_received += n;
+		used += n;
+	}
+
+	return used;
+}
+
+/**
+ * @function	int Receive(int sock)
+ * @brief	直接读socket到对齐缓冲，缓冲满后整块写盘；
+ *		每次最多读剩余长度，升级数据后的请求帧留在socket中
+ * @return	UPGRADE_RECV_AGAIN/UPGRADE_RECV_DONE/UPGRADE_RECV_CLOSED/UPGRADE_RECV_BUSY
+ */
+int UpgradeReceiver::Receive(int sock)
+{
+	while (!Done()) {
+		if (_fill == UPGRADE_BUF_SIZE && Submit() < 0)
+			return UPGRADE_RECV_BUSY;
+
+		unsigned int n = _total - _received;
+		if (n > UPGRADE_BUF_SIZE - _fill)
+			n = UPGRADE_BUF_SIZE - _fill;
+
+		ssize_t ret;
+		if (_buf != NULL) {
+			ret = read(sock, _buf + _fill, n);
+		} else {
+			char discard[1024];
+			ret = read(sock, discard, n < sizeof(discard) ? n : sizeof(discard));
+		}
+		if (ret > 0) {
+			if (_buf != NULL)
+				_crc = crc32c(_crc, _buf + _fill, ret);
+			_fill += ret;
+			_received += ret;
+			continue;
+		}
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			return UPGRADE_RECV_AGAIN;
+		Debug("read sock failed");
+		return UPGRADE_RECV_CLOSED;
+	}
+
+	return UPGRADE_RECV_DONE;
+}
+
+/**
+ * @function	int Finish(bool verify, unsigned int crc)
+ * @brief	写出剩余数据并落盘，校验长度及CRC32C后将临时文件改名为安装文件
+ * @return	0成功，-1失败，-2 CRC32C不符(临时文件均已删除)
+ */
+int UpgradeReceiver::Finish(bool verify, unsigned int crc)
+{
+	if (_fill > 0 && _buf != NULL)
+		WriteOut(_buf, _fill, _received - _fill);
+	_fill = 0;
+
+	_elapsed_ms = elapsed_ms(&_start);
+
+	if (_error) {
+		Abort();
+		return -1;
+	}
+
+	if (fdatasync(_fd) < 0) {
+		Debug("sync %s failed", _path);
+		_error = true;
+	}
+
+	off_t size = lseek(_fd, 0, SEEK_END);
+	if (!_error && size != (off_t)_total) {
+		Debug("upgrade file size %ld, expect %u", (long)size, _total);
+		_error = true;
+	}
+
+	if (_error) {
+		Abort();
+		return -1;
+	}
+
+	if (verify && crc != _crc) {
+		Debug("upgrade crc32c %08x, expect %08x", _crc, crc);
+		_resumable = false;
+		Abort();
+		return -2;
+	}
+
+	CloseRing();
+	close(_fd);
+	_fd = -1;
+	if (rename(_path, _final) < 0) {
+		Debug("install %s failed", _final);
+		unlink(_path);
+		return -1;
+	}
+
+	Debug("upgrade %s: %u bytes in %u ms", _final, _received, _elapsed_ms);
+	return 0;
+}
+
+/**
+ * @function	void Abort()
+ * @brief	放弃本次升级，删除未完成的临时文件；分块续传保留以便续接
+ *
+ */
+void UpgradeReceiver::Abort()
+{
+	if (_fd >= 0) {
+		CloseRing();
+		close(_fd);
+		_fd = -1;
+		if (!_resumable)
+			unlink(_path);
+	}
+}
+
+unsigned int UpgradeReceiver::Throughput() const
+{
+	if (_elapsed_ms == 0)
+		return 0;
+
+	//0.01MB/s: bytes * 100 / (1MB * ms / 1000)
+	return (unsigned int)((unsigned long long)_received * 100 * 1000 /
+			((unsigned long long)_elapsed_ms * 1024 * 1024));
+}
@@ -0,0 +1,150 @@
+/**
+ * @file	upgrade_receiver.h
+ * @brief	升级文件流式接收类声明
+ * @author	agent <agent@local>
+ * @version	1.0.0
+ * @date	2026-10-16
+ *
+ * @verbatim
+ * ============================================================================
+ * Copyright (c) Shenzhen Landun technology Co.,Ltd. 2026
+ * All rights reserved. 
+ * 
+ * Use of this software is controlled by the terms and conditions found in the
+ * license agreenment under which this software has been supplied or provided.
+ * ============================================================================
+ * 
+ * @endverbatim
+ * 
+ */
+
+
+#ifndef _UPGRADERECEIVER_H_
+#define _UPGRADERECEIVER_H_
+
+#define UPGRADE_DIR		"/data/"
+#define UPGRADE_BUF_SIZE	(64 * 1024)	//对齐的收包/写盘缓冲
+#define UPGRADE_CHUNK_MAX	(8 * 1024)	//分块传输单块最大长度，需小于连接接收缓冲
+#define UPGRADE_WINDOW		8		//分块传输允许未确认的块数
+#define UPGRADE_SYNC_BYTES	(UPGRADE_CHUNK_MAX * UPGRADE_WINDOW / 2)	//每落盘该长度回一次进度
+#define UPGRADE_RING_ENTRIES	4
+
+/* 分块传输在两次落盘之间把数据块攒在同一个接收缓冲中，落盘前整块写出，不会写满 */
+typedef char upgrade_sync_fits_buffer[
+	UPGRADE_SYNC_BYTES + UPGRADE_CHUNK_MAX <= UPGRADE_BUF_SIZE ? 1 : -1];
+
+//Receive()返回值
+#define UPGRADE_RECV_AGAIN	0	//socket已读空
+#define UPGRADE_RECV_DONE	1	//已收满total_length
+#define UPGRADE_RECV_CLOSED	-1	//对端关闭或出错
+#define UPGRADE_RECV_BUSY	2	//两个缓冲都在等待写盘，写盘完成后继续
+
+class WorkPool;
+class IoRing;
+struct Work;
+struct payload_req;
+
+/**
+ * 整包流式升级使用两个缓冲: 一个缓冲满后交给存储工作线程写盘，
+ * 网络线程继续接收到另一个缓冲；分块续传的数据块同样拷入接收缓冲，
+ * 每次落盘前交给工作线程写出。落盘和最后的安装也在
+ * 存储工作线程执行，完成后由reactor调用JobDone并发送应答。
+ * 有任务未完成时不能删除，连接断开时用Orphan()交给最后一个任务的完成处理删除。
+ */
+class UpgradeReceiver
+{
+
+public:
+	UpgradeReceiver(unsigned int req_type);
+	~UpgradeReceiver();
+
+	void SetPool(WorkPool *pool, unsigned int conn_id);
+	void EnableIoUring() { _use_ring = true; }
+	void PostSync(const struct payload_req *req);
+	void PostFinish(const struct payload_req *req, bool verify = false,
+			unsigned int crc = 0);
+	void JobDone(struct Work *work);
+	bool Busy() const { return _jobs > 0; }
+	void Orphan() { _orphan = true; }
+	void Expect(unsigned int crc) { _verify = true; _expect_crc = crc; }
+	bool Verify() const { return _verify; }
+	unsigned int ExpectedCrc() const { return _expect_crc; }
+	bool Orphaned() const { return _orphan; }
+
+	int  Begin(const char *file_name, unsigned int total_length);
+	int  Resume(const struct payload_req *req, const char *file_name,
+		    unsigned int total_length);
+	int  WriteChunk(unsigned int offset, const char *data, unsigned int len);
+	bool SyncDue() const { return _received - _sync_posted >= UPGRADE_SYNC_BYTES; }
+	unsigned int Feed(const char *data, unsigned int len);
+	int  Receive(int sock);
+	int  Finish(bool verify = false, unsigned int crc = 0);
+	void Abort();
+
+	bool Done() const { return _received >= _total; }
+	bool Streaming() const { return !_resumable; }
+	bool Matches(const char *file_name, unsigned int total_length) const;
+	unsigned int Total() const { return _total; }
+	unsigned int Durable() const { return _durable; }
+	unsigned int Crc() const { return _crc; }
+	unsigned int ReqType() const { return _req_type; }
+	unsigned int Received() const { return _received; }
+	unsigned int ElapsedMs() const { return _elapsed_ms; }
+	unsigned int Throughput() const;
+
+private:
+	unsigned int _req_type;	//升级请求类型，应答时回填
+	int  _fd;		//目标临时文件
+	bool _error;		//写盘出错后继续收完数据以保持流同步
+	bool _resumable;	//分块续传: 断开时保留临时文件
+	char _path[512];	//临时文件/data/<name>.part
+	char _final[512];	//安装文件/data/<name>
+
+	unsigned int _total;
+	unsigned int _received;
+	unsigned int _durable;	//已fdatasync的字节数
+	unsigned int _durable_crc;	//前_durable字节的CRC32C，落盘失败时回退到此
+	unsigned int _crc;	//已接收数据的CRC32C，边收边算，无需写盘后回读
+	bool _verify;		//流式传输的开始请求附带了CRC32C
+	unsigned int _expect_crc;
+	unsigned int _elapsed_ms;
+	struct timespec _start;
+
+	unsigned int _sync_posted;	//已提交落盘的字节数
+
+	char *_bufs[2];		//双缓冲
+	int  _cur;
+	char *_buf;		//正在接收的缓冲
+	unsigned int _fill;
+	bool _writing;		//另一个缓冲正在写盘
+
+	WorkPool *_pool;
+	unsigned int _conn_id;	//完成时应答的连接
+	int  _jobs;		//未完成的工作线程任务
+	bool _orphan;		//连接已放弃本对象
+
+	IoRing *_ring;		//整包写盘用的io_uring，目标文件注册为固定文件
+	bool _use_ring;
+
+	int  SetTarget(const char *file_name);
+	int  OpenTarget(int flags);
+	int  Create();
+	int  Reopen();
+	int  PostOpen(const struct payload_req *req, void (*run)(struct Work *));
+	int  AllocBuffers();
+	void Rollback();
+	int  Submit();
+	int  WriteOut(const char *buf, unsigned int len, unsigned int offset);
+	bool OpenRing();
+	void CloseRing();
+	int  RingWrite(const char *buf, unsigned int len, unsigned int offset);
+	int  CrcPrefix(unsigned int len);
+
+	static void CreateJob(struct Work *work);
+	static void ReopenJob(struct Work *work);
+	static void WriteJob(struct Work *work);
+	static void SyncJob(struct Work *work);
+	static void FinishJob(struct Work *work);
+};
+
+#endif
@@ -0,0 +1,263 @@
+/**
+ * @file	work_pool.cpp
+ * @brief	耗时任务工作线程类实现
+ * @author	agent <agent@local>
+ * @version 	1.0.0
+ * @date 	2026-10-16
+ *
+ * @verbatim
+ * ============================================================================
+ * Copyright (c) Shenzhen Landun technology Co.,Ltd. 2026
+ * All rights reserved. 
+ * 
+ * Use of this software is controlled by the terms and conditions found in the
+ * license agreenment under which this software has been supplied or provided.
+ * ============================================================================
+ * 
+ * @endverbatim
+ * 
+ */
+
+
+#include <unistd.h>
+#include <string.h>
+#include <stdint.h>
+#include <sys/eventfd.h>
+#include "debug.h"
+#include "slab.h"
+#include "work_pool.h"
+
+
+WorkQueue::WorkQueue()
+{
+	_pool = NULL;
+	_head = NULL;
+	_tail = NULL;
+	_running = false;
+	_quit = false;
+	pthread_mutex_init(&_lock, NULL);
+	pthread_cond_init(&_cond, NULL);
+}
+
+WorkQueue::~WorkQueue()
+{
+	pthread_cond_destroy(&_cond);
+	pthread_mutex_destroy(&_lock);
+}
+
+int WorkQueue::Init(WorkPool *pool)
+{
+	_pool = pool;
+	_running = true;
+	if (Start() != 0) {
+		_running = false;
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * @function	void Push(struct Work *work)
+ * @brief	加入队列尾部；线程未能启动或已退出时在调用线程中直接执行。
+ *		其他reactor也会提交，持锁判断线程状态
+ *
+ */
+void WorkQueue::Push(struct Work *work)
+{
+	work->next = NULL;
+	pthread_mutex_lock(&_lock);
+	if (!_running) {
+		pthread_mutex_unlock(&_lock);
+		work->run(work);
+		Finish(work);
+		return;
+	}
+
+	if (_tail != NULL)
+		_tail->next = work;
+	else
+		_head = work;
+	_tail = work;
+	pthread_cond_broadcast(&_cond);
+	pthread_mutex_unlock(&_lock);
+}
+
+/**
+ * @function	void Quit()
+ * @brief	通知线程退出并等待其执行完队列中的任务
+ *
+ */
+void WorkQueue::Quit()
+{
+	pthread_mutex_lock(&_lock);
+	_quit = true;
+	pthread_cond_broadcast(&_cond);
+	while (_running)
+		pthread_cond_wait(&_cond, &_lock);
+	pthread_mutex_unlock(&_lock);
+}
+
+/* 退出前执行完已入队的任务，保证升级文件等写完整 */
+void WorkQueue::Run()
+{
+	pthread_mutex_lock(&_lock);
+	while (1) {
+		struct Work *work = _head;
+		if (work == NULL) {
+			if (_quit || IsTerminated())
+				break;
+			pthread_cond_wait(&_cond, &_lock);
+			continue;
+		}
+
+		_head = work->next;
+		if (_head == NULL)
+			_tail = NULL;
+		pthread_mutex_unlock(&_lock);
+
+		work->run(work);
+		Finish(work);
+
+		pthread_mutex_lock(&_lock);
+	}
+	_running = false;
+	pthread_cond_broadcast(&_cond);
+	pthread_mutex_unlock(&_lock);
+}
+
+void WorkQueue::Finish(struct Work *work)
+{
+	if (work->owner != NULL)
+		work->owner->Done(work);
+	else
+		_pool->Done(work);
+}
+
+
+WorkPool::WorkPool()
+{
+	_event_fd = -1;
+	_done_head = NULL;
+	_done_tail = NULL;
+	pthread_mutex_init(&_lock, NULL);
+}
+
+WorkPool::~WorkPool()
+{
+	Shutdown();
+	while (_done_head != NULL) {
+		struct Work *work = _done_head;
+		_done_head = work->next;
+		Free(work);
+	}
+	pthread_mutex_destroy(&_lock);
+}
+
+int WorkPool::Init()
+{
+	_event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (_event_fd < 0) {
+		Debug("create work eventfd failed");
+		return -1;
+	}
+
+	for (int i = 0; i < WORK_CLASS_NUM; i++) {
+		if (_queues[i].Init(this) < 0)
+			Debug("start work queue %d failed, run inline", i);
+	}
+
+	return 0;
+}
+
+void WorkPool::Shutdown()
+{
+	for (int i = 0; i < WORK_CLASS_NUM; i++)
+		_queues[i].Quit();
+
+	//其他reactor可能同时调用Done，持锁关闭
+	pthread_mutex_lock(&_lock);
+	if (_event_fd >= 0) {
+		close(_event_fd);
+		_event_fd = -1;
+	}
+	pthread_mutex_unlock(&_lock);
+}
+
+//任务在一个reactor中申请，可能在另一个reactor中释放(WORK_NOTIFY)，池加锁
+static Slab work_slab(sizeof(struct Work), 32, true, WORK_RESERVE);
+
+struct Work *WorkPool::Alloc(int klass, int type, void (*run)(struct Work *))
+{
+	//池无法扩展时退回new，调用方不需检查NULL
+	struct Work *work = (struct Work *)work_slab.Alloc();
+	bool pooled = work != NULL;
+	if (!pooled)
+		work = new Work;
+	memset(work, 0, sizeof(*work));
+	work->pooled = pooled;
+	work->klass = klass;
+	work->type  = type;
+	work->run   = run;
+	return work;
+}
+
+void WorkPool::Free(struct Work *work)
+{
+	if (work->pooled)
+		work_slab.Free(work);
+	else
+		delete work;
+}
+
+void WorkPool::Stat(struct SlabStat *stat)
+{
+	work_slab.GetStat(stat);
+}
+
+void WorkPool::Post(struct Work *work)
+{
+	_queues[work->klass].Push(work);
+}
+
+/**
+ * @function	void Done(struct Work *work)
+ * @brief	工作线程执行完任务后挂入完成链表并唤醒reactor
+ *
+ */
+void WorkPool::Done(struct Work *work)
+{
+	pthread_mutex_lock(&_lock);
+	work->next = NULL;
+	if (_done_tail != NULL)
+		_done_tail->next = work;
+	else
+		_done_head = work;
+	_done_tail = work;
+
+	if (_event_fd >= 0) {
+		uint64_t one = 1;
+		ssize_t ret = write(_event_fd, &one, sizeof(one));
+		ret = ret;
+	}
+	pthread_mutex_unlock(&_lock);
+}
+
+/**
+ * @function	struct Work *Complete()
+ * @brief	reactor取出全部已完成的任务，按完成顺序以next链接，处理后由调用方WorkPool::Free
+ *
+ */
+struct Work *WorkPool::Complete()
+{
+	uint64_t count;
+	ssize_t ret = read(_event_fd, &count, sizeof(count));
+	ret = ret;
+
+	pthread_mutex_lock(&_lock);
+	struct Work *work = _done_head;
+	_done_head = NULL;
+	_done_tail = NULL;
+	pthread_mutex_unlock(&_lock);
+
+	return work;
+}
@@ -0,0 +1,135 @@
+/**
+ * @file	work_pool.h
+ * @brief	耗时任务工作线程类声明
+ * @author	agent <agent@local>
+ * @version	1.0.0
+ * @date	2026-10-16
+ *
+ * @verbatim
+ * ============================================================================
+ * Copyright (c) Shenzhen Landun technology Co.,Ltd. 2026
+ * All rights reserved. 
+ * 
+ * Use of this software is controlled by the terms and conditions found in the
+ * license agreenment under which this software has been supplied or provided.
+ * ============================================================================
+ * 
+ * @endverbatim
+ * 
+ */
+
+
+#ifndef _WORKPOOL_H_
+#define _WORKPOOL_H_
+
+#include <pthread.h>
+#include "thread.h"
+#include "ldczn_protocol.h"
+
+/* 任务分类，每类一个队列和线程，互不阻塞 */
+#define WORK_CLASS_SENSOR	0	//传感器/闪光灯下发、模式切换
+#define WORK_CLASS_SYSTEM	1	//校时、重启
+#define WORK_CLASS_STORAGE	2	//升级文件写盘
+#define WORK_CLASS_NUM		3
+
+/* 任务类型，完成后reactor按类型发送应答 */
+#define WORK_SENSOR		0
+#define WORK_MODE		1
+#define WORK_TIME		2
+#define WORK_REBOOT		3
+#define WORK_UPGRADE_WRITE	4
+#define WORK_UPGRADE_SYNC	5
+#define WORK_UPGRADE_FINISH	6
+#define WORK_NOTIFY		7	//其他reactor转发的变化通知，不执行，直接放入完成链表
+#define WORK_UPGRADE_OPEN	8	//打开、预分配升级文件，续传时回读已落盘部分
+
+#define WORK_DATA_SIZE		64
+#define WORK_RESERVE		32	//启动时预先申请的任务数
+
+struct SlabStat;
+class WorkPool;
+
+struct Work {
+	int  klass;		//WORK_CLASS_*
+	int  type;		//WORK_*
+	void (*run)(struct Work *work);	//在工作线程中执行
+	void *arg;
+	void *ptr;
+	unsigned int len;
+	unsigned int value;
+	int  result;		//run的执行结果
+	unsigned int conn_id;	//完成后应答的连接，0表示不应答
+	WorkPool *owner;	//完成后交回的任务池(提交任务的reactor)，NULL为执行的任务池
+	struct payload_req req;	//对应的请求
+	char data[WORK_DATA_SIZE] __attribute__((aligned(8)));
+	struct Work *next;
+	bool pooled;		//取自任务池，否则为new分配
+};
+
+/* 放入Work::data的负载类型，超出WORK_DATA_SIZE时编译报错(数组长度为负) */
+#define WORK_DATA_FITS(type, name) \
+	typedef char work_data_fits_##name[sizeof(type) <= WORK_DATA_SIZE ? 1 : -1]
+
+WORK_DATA_FITS(CameraParam, camera);	//传感器参数下发
+WORK_DATA_FITS(FlashParam, flash);	//闪光灯参数下发
+WORK_DATA_FITS(Ldczn_time, time);	//校时
+
+class WorkQueue: public Thread
+{
+
+public:
+	WorkQueue();
+	~WorkQueue();
+
+	int  Init(WorkPool *pool);
+	void Push(struct Work *work);
+	void Quit();
+
+protected:
+	void Run();
+
+private:
+	WorkPool *_pool;
+	struct Work *_head;
+	struct Work *_tail;
+	bool _running;
+	bool _quit;
+	pthread_mutex_t _lock;
+	pthread_cond_t  _cond;
+
+	void Finish(struct Work *work);
+};
+
+/**
+ * 网络线程中阻塞的操作(校时、重启、传感器寄存器下发、升级写盘)放到
+ * 工作线程执行，按类别分队列，升级写盘不会延误参数下发和校时。
+ * 执行完的任务挂到完成链表并通过eventfd通知reactor，由reactor发送应答。
+ */
+class WorkPool
+{
+
+public:
+	WorkPool();
+	~WorkPool();
+
+	int  Init();
+	void Shutdown();
+	int  Fd() const { return _event_fd; }
+
+	static struct Work *Alloc(int klass, int type, void (*run)(struct Work *));
+	static void Free(struct Work *work);
+	static void Stat(struct SlabStat *stat);
+	void Post(struct Work *work);
+	struct Work *Complete();
+	void Done(struct Work *work);
+
+private:
+	WorkQueue _queues[WORK_CLASS_NUM];
+	int  _event_fd;
+
+	struct Work *_done_head;	//已执行完、待reactor处理的任务
+	struct Work *_done_tail;
+	pthread_mutex_t _lock;
+};
+
+#endif